@@ -1,3 +1,83 @@
 COMPONENT_DEPENDS := SSDP RapidXML
 COMPONENT_INCDIRS := src/include
 COMPONENT_SRCDIRS := src
+
+# Maximum number of SSDP messages passed to the server queue at any one time
+COMPONENT_VARS += UPNP_MAX_INFLIGHT
+UPNP_MAX_INFLIGHT ?= 4
+COMPONENT_CXXFLAGS += -DUPNP_MAX_INFLIGHT=$(UPNP_MAX_INFLIGHT)
+
+# Number of pending SSDP messages which may be held by the scheduler
+COMPONENT_VARS += UPNP_MESSAGE_POOL_SIZE
+UPNP_MESSAGE_POOL_SIZE ?= 32
+GLOBAL_CFLAGS += -DUPNP_MESSAGE_POOL_SIZE=$(UPNP_MESSAGE_POOL_SIZE)
+
+# Number of pre-formatted SSDP header blocks shared by objects without field caching
+COMPONENT_VARS += UPNP_HEADER_CACHE_SIZE
+UPNP_HEADER_CACHE_SIZE ?= 8
+GLOBAL_CFLAGS += -DUPNP_HEADER_CACHE_SIZE=$(UPNP_HEADER_CACHE_SIZE)
+
+# Period (in seconds) over which all registered devices are re-advertised
+COMPONENT_VARS += UPNP_ADVERTISE_INTERVAL
+UPNP_ADVERTISE_INTERVAL ?= 800
+GLOBAL_CFLAGS += -DUPNP_ADVERTISE_INTERVAL=$(UPNP_ADVERTISE_INTERVAL)
+
+# Maximum time (in microseconds) spent searching devices per task callback
+COMPONENT_VARS += UPNP_SEARCH_TIME_BUDGET
+UPNP_SEARCH_TIME_BUDGET ?= 2000
+GLOBAL_CFLAGS += -DUPNP_SEARCH_TIME_BUDGET=$(UPNP_SEARCH_TIME_BUDGET)
+
+# How far ahead (in milliseconds) of their due time queued messages are passed to the scheduler
+COMPONENT_VARS += UPNP_SEARCH_LOOKAHEAD
+UPNP_SEARCH_LOOKAHEAD ?= 200
+GLOBAL_CFLAGS += -DUPNP_SEARCH_LOOKAHEAD=$(UPNP_SEARCH_LOOKAHEAD)
+
+# Number of searches and announcements in progress which can be allocated without using the heap
+COMPONENT_VARS += UPNP_SEARCH_POOL_SIZE
+UPNP_SEARCH_POOL_SIZE ?= 4
+GLOBAL_CFLAGS += -DUPNP_SEARCH_POOL_SIZE=$(UPNP_SEARCH_POOL_SIZE)
+
+# Maximum nesting of embedded devices for searches processed via the task queue
+COMPONENT_VARS += UPNP_TREE_DEPTH
+UPNP_TREE_DEPTH ?= 8
+GLOBAL_CFLAGS += -DUPNP_TREE_DEPTH=$(UPNP_TREE_DEPTH)
+
+# Number of remote addresses tracked for M-SEARCH rate limiting
+COMPONENT_VARS += UPNP_RATELIMIT_SOURCES
+UPNP_RATELIMIT_SOURCES ?= 8
+GLOBAL_CFLAGS += -DUPNP_RATELIMIT_SOURCES=$(UPNP_RATELIMIT_SOURCES)
+
+# Number of network interfaces for which each root device caches its base URL
+COMPONENT_VARS += UPNP_URL_CACHE_SIZE
+UPNP_URL_CACHE_SIZE ?= 2
+GLOBAL_CFLAGS += -DUPNP_URL_CACHE_SIZE=$(UPNP_URL_CACHE_SIZE)
+
+# Number of list enumerators which can be allocated without using the heap
+COMPONENT_VARS += UPNP_ENUMERATOR_POOL_SIZE
+UPNP_ENUMERATOR_POOL_SIZE ?= 8
+COMPONENT_CXXFLAGS += -DUPNP_ENUMERATOR_POOL_SIZE=$(UPNP_ENUMERATOR_POOL_SIZE)
+
+# Store cached descriptions in the filesystem instead of RAM
+COMPONENT_VARS += UPNP_DESCRIPTION_CACHE_FILES
+ifeq ($(SMING_ARCH),Esp8266)
+UPNP_DESCRIPTION_CACHE_FILES ?= 1
+else
+UPNP_DESCRIPTION_CACHE_FILES ?= 0
+endif
+GLOBAL_CFLAGS += -DUPNP_DESCRIPTION_CACHE_FILES=$(UPNP_DESCRIPTION_CACHE_FILES)
+
+# Generates a RootDevice class from a device description file, see tools/devicegen.py
+UPNP_DEVICEGEN := $(PYTHON) $(COMPONENT_PATH)/tools/devicegen.py
+
+# Description files to be compressed for sending with 'Content-Encoding: gzip', set by the application.
+# Each file is written to $(UPNP_GZIP_DIR)/<name>.gz, for importing into flash using the UPNP_GZIP_DIR macro.
+UPNP_GZIP_DIR := $(BUILD_BASE)/upnp-gz
+GLOBAL_CFLAGS += -DUPNP_GZIP_DIR=\"$(UPNP_GZIP_DIR)\"
+
+define UpnpGzipRule
+CUSTOM_TARGETS += $(UPNP_GZIP_DIR)/$(notdir $1).gz
+$(UPNP_GZIP_DIR)/$(notdir $1).gz: $1
+	$$(Q) mkdir -p $$(@D)
+	$$(Q) gzip -9 -n -c $$< > $$@
+endef
+$(foreach f,$(UPNP_GZIP_FILES),$(eval $(call UpnpGzipRule,$f)))
@@ -2,7 +2,9 @@
 #include <Platform/Station.h>
 
 IMPORT_FSTR(WEMO_SERVICE_SCPD, COMPONENT_PATH "/config/wemo-service.xml");
+IMPORT_FSTR(WEMO_SERVICE_SCPD_GZ, UPNP_GZIP_DIR "/wemo-service.xml.gz");
 IMPORT_FSTR(WEMO_METAINFO_SCPD, COMPONENT_PATH "/config/wemo-metainfo.xml");
+IMPORT_FSTR(WEMO_METAINFO_SCPD_GZ, UPNP_GZIP_DIR "/wemo-metainfo.xml.gz");
 
 namespace Wemo
 {
@@ -61,29 +63,11 @@ void MetaInfoService::handleAction(ActionInfo& info)
 
 String Controllee::getField(Field desc)
 {
+	// Constant fields are generated from wemo-device.xml, see component.mk
 	switch(desc) {
-	case Field::domain:
-		return F("Belkin");
-
-	case Field::type:
-		return F("controllee");
-
 	case Field::friendlyName:
 		return name_;
 
-	case Field::manufacturer:
-		return F("Belkin International Inc.");
-	case Field::manufacturerURL:
-		return F("http://www.belkin.com");
-	case Field::modelDescription:
-		return F("Belkin Plugin Socket 1.0");
-
-	case Field::modelName:
-		return F("Emulated Socket");
-	case Field::modelNumber:
-		return F("3.1415");
-	case Field::modelURL:
-		return F("http://www.belkin.com/plugin/");
 	case Field::serialNumber: {
 		String s = F("221517K01017xxxx");
 		s[12] = hexchar((id_ >> 16) & 0x0f);
@@ -93,15 +77,8 @@ String Controllee::getField(Field desc)
 		return s;
 	}
 
-	case Field::UDN: {
-		String s;
-		s += "uuid:Socket-1_0-";
-		s += getField(Field::serialNumber);
-		return s;
-	}
-
 	case Field::baseURL: {
-		String url = RootDevice::getField(desc);
+		String url = ControlleeBase::getField(desc);
 		url += _F("wemo/");
 		url += id_;
 		url += '/';
@@ -109,10 +86,10 @@ String Controllee::getField(Field desc)
 	}
 
 	case Field::serverId:
-		return RootDevice::getField(desc) + " Unspecified"; //" Wemo/1.0";
+		return ControlleeBase::getField(desc) + " Unspecified"; //" Wemo/1.0";
 
 	default:
-		return RootDevice::getField(desc);
+		return ControlleeBase::getField(desc);
 	}
 }
 
@@ -121,7 +98,7 @@ bool Controllee::formatMessage(Message& msg, MessageSpec& ms)
 	msg["01-NLS"] = F("b9200ebb-736d-4b93-bf03-835149d13983");
 	msg["OPT"] = F("\"http://schemas.upnp.org/upnp/1/0/\"; ns=01");
 	msg["X-User-Agent"] = F("redsonic");
-	return RootDevice::formatMessage(msg, ms);
+	return ControlleeBase::formatMessage(msg, ms);
 }
 
 } // namespace Wemo
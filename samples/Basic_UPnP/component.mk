@@ -2,3 +2,16 @@ DISABLE_SPIFFS := 1
 ARDUINO_LIBRARIES := UPnP
 
 COMPONENT_DEPENDS := malloc_count
+
+# The Wemo device class is generated from its description, which is stored in flash as a template
+DEVICEGEN_DIR := $(BUILD_BASE)/devicegen
+CUSTOM_TARGETS += $(DEVICEGEN_DIR)/WemoDevice.cpp
+COMPONENT_INCDIRS += $(DEVICEGEN_DIR)
+COMPONENT_SRCFILES += $(DEVICEGEN_DIR)/WemoDevice.cpp
+
+$(DEVICEGEN_DIR)/WemoDevice.cpp: config/wemo-device.xml
+	$(Q) $(UPNP_DEVICEGEN) $< $(basename $@) --class ControlleeBase --namespace Wemo
+
+# Service descriptions are imported into flash together with gzip-compressed versions,
+# which are sent to clients that accept them
+UPNP_GZIP_FILES := config/wemo-service.xml config/wemo-metainfo.xml
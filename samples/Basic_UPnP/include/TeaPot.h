@@ -1,5 +1,38 @@
 #include <Network/UPnP/RootDevice.h>
 
+namespace TeaPotFields
+{
+DEFINE_FSTR_LOCAL(deviceType, "upnp:tea-pot") // This device is a tea pot
+DEFINE_FSTR_LOCAL(UDN, "uuid:1231313131::upnp:tea-pot") // This is the unique id of the device.
+DEFINE_FSTR_LOCAL(friendlyName, "Sming Tea Pot")
+DEFINE_FSTR_LOCAL(modelName, "Simple tea pot")
+DEFINE_FSTR_LOCAL(manufacturer, "Sming")
+DEFINE_FSTR_LOCAL(manufacturerURL, "https://github.com/SmingHub/Sming")
+DEFINE_FSTR_LOCAL(modelDescription, "Simple UPnP test device for Sming")
+DEFINE_FSTR_LOCAL(modelNumber, "1")
+DEFINE_FSTR_LOCAL(serialNumber, "12345678")
+
+using Field = UPnP::Device::Field;
+
+/*
+ * Constant fields are stored in flash and read without calling getField().
+ * Fields not listed here are left out of the device description.
+ */
+static constexpr UPnP::Device::Descriptor descriptor PROGMEM =
+	UPnP::Device::Descriptor()
+		.value(Field::deviceType, deviceType)
+		.value(Field::UDN, UDN)
+		.value(Field::friendlyName, friendlyName)
+		.value(Field::modelName, modelName)
+		.value(Field::manufacturer, manufacturer)
+		.value(Field::manufacturerURL, manufacturerURL)
+		.value(Field::modelDescription, modelDescription)
+		.value(Field::modelNumber, modelNumber)
+		.value(Field::serialNumber, serialNumber)
+		.dynamic(Field::presentationURL);
+
+} // namespace TeaPotFields
+
 class TeaPot : public UPnP::RootDevice
 {
 public:
@@ -7,27 +40,14 @@ public:
 	{
 	}
 
+	const Descriptor* getDescriptor() override
+	{
+		return &TeaPotFields::descriptor;
+	}
+
 	String getField(Field desc) override
 	{
 		switch(desc) {
-		case Field::deviceType:
-			return F("upnp:tea-pot"); // This device is a tea pot
-		case Field::UDN:
-			return F("uuid:1231313131::upnp:tea-pot"); // This is the unique id of the device.
-		case Field::friendlyName:
-			return F("Sming Tea Pot");
-		case Field::modelName:
-			return F("Simple tea pot");
-		case Field::manufacturer:
-			return F("Sming");
-		case Field::manufacturerURL:
-			return F("https://github.com/SmingHub/Sming");
-		case Field::modelDescription:
-			return F("Simple UPnP test device for Sming");
-		case Field::modelNumber:
-			return F("1");
-		case Field::serialNumber:
-			return F("12345678");
 		case Field::baseURL: {
 			// Ensure URL is unique if there are multiple devices
 			String s;
@@ -1,11 +1,13 @@
 #pragma once
 
-#include <Network/UPnP/RootDevice.h>
+#include <WemoDevice.h>
 #include <Network/UPnP/Enumerator.h>
 #include <Data/Stream/FlashMemoryStream.h>
 
 DECLARE_FSTR(WEMO_SERVICE_SCPD);
+DECLARE_FSTR(WEMO_SERVICE_SCPD_GZ);
 DECLARE_FSTR(WEMO_METAINFO_SCPD);
+DECLARE_FSTR(WEMO_METAINFO_SCPD_GZ);
 
 namespace Wemo
 {
@@ -31,6 +33,11 @@ public:
 		return new FlashMemoryStream(WEMO_SERVICE_SCPD);
 	}
 
+	IDataSourceStream* createCompressedDescription() override
+	{
+		return new FlashMemoryStream(WEMO_SERVICE_SCPD_GZ);
+	}
+
 	void handleAction(ActionInfo& info) override;
 };
 
@@ -44,10 +51,15 @@ public:
 		return new FlashMemoryStream(WEMO_METAINFO_SCPD);
 	}
 
+	IDataSourceStream* createCompressedDescription() override
+	{
+		return new FlashMemoryStream(WEMO_METAINFO_SCPD_GZ);
+	}
+
 	void handleAction(ActionInfo& info) override;
 };
 
-class Controllee : public RootDevice
+class Controllee : public ControlleeBase
 {
 public:
 	using StateChangeDelegate = Delegate<void(Controllee& device)>;
@@ -0,0 +1,179 @@
+#include <SmingCore.h>
+#include <Network/UPnP/DeviceHost.h>
+#include <Network/SSDP/Server.h>
+#include <SyntheticDevice.h>
+#include <malloc_count.h>
+#include <algorithm>
+
+// Defaults, normally set in component.mk
+#ifndef BENCH_ROOT_DEVICES
+#define BENCH_ROOT_DEVICES 8
+#endif
+#ifndef BENCH_EMBEDDED_DEVICES
+#define BENCH_EMBEDDED_DEVICES 4
+#endif
+#ifndef BENCH_SERVICES
+#define BENCH_SERVICES 2
+#endif
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 1000
+#endif
+
+namespace
+{
+using namespace Synthetic;
+
+// Used to obtain a serviceType to search for
+Service* lastService;
+
+RootDevice* buildTree(unsigned rootId)
+{
+	auto root = new BenchRootDevice(rootId);
+	for(unsigned s = 0; s < BENCH_SERVICES; ++s) {
+		lastService = new BenchService(s);
+		root->addService(lastService);
+	}
+	for(unsigned d = 0; d < BENCH_EMBEDDED_DEVICES; ++d) {
+		auto dev = new BenchDevice(BenchRootDevice::makeUdn(rootId, d), d);
+		for(unsigned s = 0; s < BENCH_SERVICES; ++s) {
+			dev->addService(new BenchService(s));
+		}
+		root->addDevice(dev);
+	}
+	return root;
+}
+
+/*
+ * Feed a crafted M-SEARCH request into the device host repeatedly and report timings.
+ * Messages are discarded from the scheduler as they're queued, as if they'd been sent,
+ * so every iteration starts from the same state and the pool is never exhausted.
+ */
+void runTarget(const String& st)
+{
+	String text = F("M-SEARCH * HTTP/1.1\r\n"
+					"HOST: 239.255.255.250:1900\r\n"
+					"MAN: \"ssdp:discover\"\r\n"
+					"MX: 3\r\n"
+					"ST: ");
+	text += st;
+	text += "\r\n\r\n";
+
+	auto& scheduler = UPnP::deviceHost.getScheduler();
+	auto dropped = scheduler.getStats().dropped;
+	auto times = new uint32_t[BENCH_ITERATIONS];
+	char buffer[256];
+	unsigned textLength = std::min(text.length(), sizeof(buffer) - 1);
+	uint64_t totalTime{0};
+	unsigned queued{0};
+	unsigned allocs{0};
+
+	for(unsigned i = 0; i < BENCH_ITERATIONS; ++i) {
+		// Message is parsed in-place
+		memcpy(buffer, text.c_str(), textLength);
+		buffer[textLength] = '\0';
+		SSDP::BasicMessage msg;
+		msg.parse(buffer, textLength);
+		if(msg.type != MessageType::msearch) {
+			Serial.print(_F("Bad request: "));
+			Serial.println(st);
+			delete[] times;
+			return;
+		}
+		msg.remoteIP = IpAddress(192, 168, 1, 2 + (i % 200));
+		msg.remotePort = 1900;
+
+		MallocCount::resetAllocCount();
+		auto startTime = micros();
+		UPnP::deviceHost.onSearchRequest(msg);
+		// Searches over all devices are normally completed via the task queue
+		queued += scheduler.count();
+		scheduler.clear();
+		while(UPnP::deviceHost.isSearching()) {
+			UPnP::deviceHost.processSearches();
+			queued += scheduler.count();
+			scheduler.clear();
+		}
+		auto elapsed = micros() - startTime;
+		allocs += MallocCount::getAllocCount();
+
+		times[i] = elapsed;
+		totalTime += elapsed;
+	}
+
+	std::sort(times, times + BENCH_ITERATIONS);
+	auto p50 = times[BENCH_ITERATIONS / 2];
+	auto p99 = times[(BENCH_ITERATIONS * 99) / 100];
+	delete[] times;
+
+	unsigned reqPerSec = (totalTime == 0) ? 0 : unsigned(uint64_t(BENCH_ITERATIONS) * 1000000ULL / totalTime);
+
+	Serial.println(st);
+	Serial.printf(_F("  requests/sec: %u, queued/request: %u, allocs/request: %u\r\n"), reqPerSec,
+				  queued / BENCH_ITERATIONS, allocs / BENCH_ITERATIONS);
+	Serial.printf(_F("  p50: %u us, p99: %u us, dropped: %u\r\n"), p50, p99,
+				  unsigned(scheduler.getStats().dropped - dropped));
+}
+
+void runBenchmark()
+{
+	auto heapStart = MallocCount::getCurrent();
+
+	RootDevice* roots[BENCH_ROOT_DEVICES];
+	for(unsigned r = 0; r < BENCH_ROOT_DEVICES; ++r) {
+		roots[r] = buildTree(r);
+	}
+	UPnP::deviceHost.registerDevices(roots, BENCH_ROOT_DEVICES);
+
+	Serial.printf(_F("\r\nSSDP search benchmark: %u root devices, %u embedded devices, %u services per device\r\n"),
+				  BENCH_ROOT_DEVICES, BENCH_EMBEDDED_DEVICES, BENCH_SERVICES);
+	Serial.printf(_F("Device tree heap usage: %u bytes, %u iterations per request\r\n\r\n"),
+				  unsigned(MallocCount::getCurrent() - heapStart), BENCH_ITERATIONS);
+
+	// Responses are limited by the scheduler pool and rate limiter, so don't measure those
+	UPnP::deviceHost.getRateLimiter().setEnabled(false);
+	// Don't wait for messages to fall due: generate them as soon as the pool has room
+	UPnP::deviceHost.setSearchLookahead(10000);
+
+	auto lastRoot = roots[BENCH_ROOT_DEVICES - 1];
+	String deviceType = lastRoot->getField(Device::Field::deviceType);
+	String udn = lastRoot->getField(Device::Field::UDN);
+	String serviceType;
+	if(lastService != nullptr) {
+		serviceType = lastService->getField(Service::Field::serviceType);
+	}
+
+	MallocCount::resetPeak();
+
+	runTarget(SSDP::SSDP_ALL);
+	runTarget(SSDP::UPNP_ROOTDEVICE);
+	runTarget(deviceType);
+	if(serviceType) {
+		runTarget(serviceType);
+	}
+	runTarget(udn);
+
+	Serial.printf(_F("\r\nPeak heap during search: %u bytes\r\n"), unsigned(MallocCount::getPeak() - heapStart));
+
+	auto& stats = UPnP::deviceHost.getScheduler().getStats();
+	Serial.printf(_F("Scheduler: %u scheduled, %u suppressed, %u dropped\r\n"), stats.scheduled, stats.suppressed,
+				  stats.dropped);
+
+#ifdef ARCH_HOST
+	exit(0);
+#endif
+}
+
+} // namespace
+
+void init()
+{
+	Serial.setTxBufferSize(4096);
+	Serial.begin(SERIAL_BAUD_RATE);
+	Serial.systemDebugOutput(true);
+
+	// Network is not required
+	WifiStation.enable(false, false);
+	WifiAccessPoint.enable(false, false);
+
+	System.queueCallback(runBenchmark);
+}
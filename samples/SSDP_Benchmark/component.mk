@@ -0,0 +1,26 @@
+DISABLE_SPIFFS := 1
+ARDUINO_LIBRARIES := UPnP
+
+COMPONENT_DEPENDS := malloc_count
+
+# Number of root devices to register
+COMPONENT_VARS += BENCH_ROOT_DEVICES
+BENCH_ROOT_DEVICES ?= 8
+
+# Number of embedded devices in each root device
+COMPONENT_VARS += BENCH_EMBEDDED_DEVICES
+BENCH_EMBEDDED_DEVICES ?= 4
+
+# Number of services in each device
+COMPONENT_VARS += BENCH_SERVICES
+BENCH_SERVICES ?= 2
+
+# Number of requests to handle for each search target
+COMPONENT_VARS += BENCH_ITERATIONS
+BENCH_ITERATIONS ?= 1000
+
+COMPONENT_CXXFLAGS += \
+	-DBENCH_ROOT_DEVICES=$(BENCH_ROOT_DEVICES) \
+	-DBENCH_EMBEDDED_DEVICES=$(BENCH_EMBEDDED_DEVICES) \
+	-DBENCH_SERVICES=$(BENCH_SERVICES) \
+	-DBENCH_ITERATIONS=$(BENCH_ITERATIONS)
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Network/UPnP/RootDevice.h>
+
+/*
+ * Minimal devices and services used to populate the device tree for benchmarking.
+ * Field values follow the same pattern as real devices so messages are of realistic size.
+ */
+namespace Synthetic
+{
+using namespace UPnP;
+
+class BenchService : public Service
+{
+public:
+	BenchService(unsigned id) : id_(id)
+	{
+	}
+
+	String getField(Field desc) override
+	{
+		switch(desc) {
+		case Field::type: {
+			String s = F("benchservice");
+			s += id_;
+			return s;
+		}
+		case Field::serviceId: {
+			String s = F("urn:upnp-org:serviceId:benchservice");
+			s += id_;
+			return s;
+		}
+		default:
+			return Service::getField(desc);
+		}
+	}
+
+	void handleAction(ActionInfo& info) override
+	{
+	}
+
+private:
+	unsigned id_;
+};
+
+class BenchDevice : public Device
+{
+public:
+	BenchDevice(const String& udn, unsigned id) : udn_(udn), id_(id)
+	{
+	}
+
+	String getField(Field desc) override
+	{
+		switch(desc) {
+		case Field::type: {
+			String s = F("benchdevice");
+			s += id_;
+			return s;
+		}
+		case Field::UDN:
+			return udn_;
+		case Field::friendlyName:
+			return udn_;
+		case Field::manufacturer:
+			return F("Sming");
+		case Field::modelName:
+			return F("Benchmark device");
+		default:
+			return Device::getField(desc);
+		}
+	}
+
+private:
+	String udn_;
+	unsigned id_;
+};
+
+class BenchRootDevice : public RootDevice
+{
+public:
+	BenchRootDevice(unsigned id) : id_(id)
+	{
+	}
+
+	String getField(Field desc) override
+	{
+		switch(desc) {
+		case Field::type:
+			return F("benchroot");
+		case Field::UDN:
+			return makeUdn(id_);
+		case Field::friendlyName:
+			return makeUdn(id_);
+		case Field::manufacturer:
+			return F("Sming");
+		case Field::modelName:
+			return F("Benchmark root device");
+		case Field::baseURL: {
+			// Ensure URL is unique if there are multiple devices
+			String s;
+			s += F("/bench/");
+			s += id_;
+			s += '/';
+			return s;
+		}
+		default:
+			return RootDevice::getField(desc);
+		}
+	}
+
+	static String makeUdn(unsigned rootId, int deviceId = -1)
+	{
+		char buf[64];
+		if(deviceId < 0) {
+			m_snprintf(buf, sizeof(buf), "uuid:b3c40000-0000-4000-8000-%012u", rootId);
+		} else {
+			m_snprintf(buf, sizeof(buf), "uuid:b3c40000-%04u-4000-8000-%012u", deviceId, rootId);
+		}
+		return buf;
+	}
+
+private:
+	unsigned id_;
+};
+
+} // namespace Synthetic
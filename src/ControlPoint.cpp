@@ -34,6 +34,7 @@ bool ControlPoint::beginSearch(const UPnP::Urn& urn, DescriptionCallback callbac
 	}
 
 	searchUrn = urn;
+	searchHash = urn.hash();
 	searchCallback = callback;
 
 	deviceHost.registerControlPoint(this);
@@ -54,8 +55,15 @@ bool ControlPoint::formatMessage(SSDP::Message& message, SSDP::MessageSpec& ms)
 
 void ControlPoint::onNotify(SSDP::BasicMessage& message)
 {
-	String st = searchUrn;
-	if(st != message["NT"] && st != message["ST"]) {
+	// Parse in-place and compare hashes first, avoiding building the URN string for every message
+	auto matches = [this](const char* value) {
+		if(value == nullptr) {
+			return false;
+		}
+		UrnRef ref(value);
+		return ref && ref.hash == searchHash && searchUrn == ref;
+	};
+	if(!matches(message["NT"]) && !matches(message["ST"])) {
 		return;
 	}
 
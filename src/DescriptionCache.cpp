@@ -0,0 +1,247 @@
+/**
+ * DescriptionCache.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/DescriptionCache.h"
+#if UPNP_DESCRIPTION_CACHE_FILES
+#include <FileSystem.h>
+#include <Data/Stream/FileStream.h>
+#endif
+
+namespace
+{
+#if !UPNP_DESCRIPTION_CACHE_FILES
+/**
+ * @brief Reads from cached content, which stays in memory whilst any stream refers to it
+ */
+class CachedContentStream : public IDataSourceStream
+{
+public:
+	CachedContentStream(std::shared_ptr<const String> content) : content(content)
+	{
+	}
+
+	uint16_t readMemoryBlock(char* data, int bufSize) override
+	{
+		if(bufSize <= 0) {
+			return 0;
+		}
+
+		auto len = std::min(size_t(bufSize), content->length() - readPos);
+		memcpy(data, content->c_str() + readPos, len);
+		return len;
+	}
+
+	bool seek(int len) override
+	{
+		if(len < 0 || readPos + len > content->length()) {
+			return false;
+		}
+
+		readPos += len;
+		return true;
+	}
+
+	bool isFinished() override
+	{
+		return readPos >= content->length();
+	}
+
+	int available() override
+	{
+		return content->length() - readPos;
+	}
+
+private:
+	std::shared_ptr<const String> content;
+	size_t readPos{0};
+};
+#else
+// Gives each file a unique name, so a replacement never overwrites a file still being read
+uint16_t fileSequence;
+
+/*
+ * Files from a previous boot are never referred to again
+ */
+void removeStaleFiles()
+{
+	static bool done;
+	if(done) {
+		return;
+	}
+	done = true;
+
+	auto files = fileList();
+	for(unsigned i = 0; i < files.count(); ++i) {
+		if(files[i].startsWith(F("upnp_"))) {
+			fileDelete(files[i]);
+		}
+	}
+}
+
+#endif
+
+} // namespace
+
+namespace UPnP
+{
+#if UPNP_DESCRIPTION_CACHE_FILES
+
+/**
+ * @brief A cached description file, deleted once the cache and all streams have released it
+ */
+class DescriptionCacheFile
+{
+public:
+	DescriptionCacheFile(const String& name) : name(name)
+	{
+	}
+
+	~DescriptionCacheFile()
+	{
+		fileDelete(name);
+	}
+
+	const String name;
+};
+
+namespace
+{
+/**
+ * @brief Reads a cached file, keeping it in place until the stream is destroyed
+ */
+class CachedFileStream : public FileStream
+{
+public:
+	CachedFileStream(std::shared_ptr<DescriptionCacheFile> file) : FileStream(file->name), file(file)
+	{
+	}
+
+	~CachedFileStream()
+	{
+		// File must be closed before it can be deleted
+		close();
+	}
+
+private:
+	std::shared_ptr<DescriptionCacheFile> file;
+};
+
+} // namespace
+
+IDataSourceStream* DescriptionCache::getStream(uint32_t version)
+{
+	if(version == 0 || version != this->version || !file) {
+		return nullptr;
+	}
+
+	auto stream = new CachedFileStream(file);
+	if(!stream->isValid()) {
+		delete stream;
+		clear();
+		return nullptr;
+	}
+
+	return stream;
+}
+
+/*
+ * Content is written to a temporary file, which is renamed only once complete
+ */
+bool DescriptionCache::update(IDataSourceStream& source, uint32_t version)
+{
+	clear();
+	removeStaleFiles();
+
+	char name[32];
+	m_snprintf(name, sizeof(name), _F("upnp_%08x.tmp"), unsigned(uintptr_t(owner)));
+	String tmpName = name;
+	FileStream tmp(tmpName, eFO_CreateNewAlways | eFO_WriteOnly);
+	if(!tmp.isValid()) {
+		debug_w("[UPnP] Cannot create '%s'", tmpName.c_str());
+		return false;
+	}
+
+	tmp.copyFrom(&source);
+	tmp.close();
+
+	if(!source.isFinished()) {
+		debug_w("[UPnP] Failed to write '%s'", tmpName.c_str());
+		fileDelete(tmpName);
+		return false;
+	}
+
+	m_snprintf(name, sizeof(name), _F("upnp_%08x_%u.xml"), unsigned(uintptr_t(owner)), ++fileSequence);
+	if(fileRename(tmpName, name) != 0) {
+		debug_w("[UPnP] Failed to rename '%s'", tmpName.c_str());
+		fileDelete(tmpName);
+		return false;
+	}
+
+	file = std::make_shared<DescriptionCacheFile>(name);
+	this->version = version;
+	return true;
+}
+
+void DescriptionCache::clear()
+{
+	// File is deleted when any streams reading it are finished
+	file.reset();
+	version = 0;
+}
+
+#else
+
+IDataSourceStream* DescriptionCache::getStream(uint32_t version)
+{
+	if(version == 0 || version != this->version || !content) {
+		return nullptr;
+	}
+
+	return new CachedContentStream(content);
+}
+
+bool DescriptionCache::update(IDataSourceStream& source, uint32_t version)
+{
+	clear();
+
+	auto newContent = std::make_shared<String>();
+	char buffer[256];
+	while(!source.isFinished()) {
+		auto len = source.readMemoryBlock(buffer, sizeof(buffer));
+		if(len == 0 || !newContent->concat(buffer, len)) {
+			debug_w("[UPnP] Failed to cache description");
+			return false;
+		}
+		source.seek(len);
+	}
+
+	content = newContent;
+	this->version = version;
+	return true;
+}
+
+void DescriptionCache::clear()
+{
+	content.reset();
+	version = 0;
+}
+
+#endif
+
+} // namespace UPnP
@@ -20,9 +20,17 @@
 #include "include/Network/UPnP/DescriptionStream.h"
 #include "include/Network/UPnP/ItemEnumerator.h"
 #include "include/Network/UPnP/RootDevice.h"
+#include "include/Network/UPnP/XmlWriter.h"
 
 #define XML_PRETTY true
 
+namespace
+{
+DEFINE_FSTR_LOCAL(tag_specVersion, "specVersion")
+DEFINE_FSTR_LOCAL(tag_major, "major")
+DEFINE_FSTR_LOCAL(tag_minor, "minor")
+} // namespace
+
 namespace UPnP
 {
 DescriptionStream::DescriptionStream(Object* object)
@@ -46,6 +54,8 @@ void DescriptionStream::freeMem()
 {
 	for(unsigned i = 0; i <= segIndex; ++i) {
 		auto& seg = segments[i];
+		seg.headerTag = nullptr;
+		seg.tag = nullptr;
 		if(seg.list == nullptr) {
 			continue;
 		}
@@ -57,7 +67,7 @@ void DescriptionStream::freeMem()
 
 String DescriptionStream::getName() const
 {
-	String s = object_->getRoot()->getField(Device::Field::descriptionURL);
+	String s = object_->getRoot()->getCachedField(Device::Field::descriptionURL);
 	int i = s.lastIndexOf('/');
 	if(i >= 0) {
 		s.remove(0, i + 1);
@@ -65,28 +75,31 @@ String DescriptionStream::getName() const
 	return s;
 }
 
+/*
+ * Close elements left open for the current segment, once its lists have been written.
+ * Tag names are obtained from the item, so nothing else needs to be stored.
+ */
+void DescriptionStream::writeFooter()
+{
+	auto& seg = segments[segIndex];
+	if(seg.tag != nullptr) {
+		XmlWriter writer(content);
+		writer.closeTag(*seg.tag);
+		content += "\r\n";
+		seg.tag = nullptr;
+	}
+	if(seg.headerTag != nullptr) {
+		XmlWriter writer(content, XML_PRETTY, 1);
+		writer.closeTag(*seg.headerTag);
+		content += "\r\n";
+		seg.headerTag = nullptr;
+	}
+}
+
 void DescriptionStream::getContent()
 {
 	auto seg = &segments[segIndex];
 
-	XML::Document doc;
-
-	// Find closing tag and move it into the footer
-	auto splitTag = [&](XML::Node* node) {
-		String tag;
-		tag.reserve(3 + node->name_size());
-		tag += "</";
-		tag.concat(node->name(), node->name_size());
-		tag += '>';
-		int i = content.indexOf(tag);
-		assert(i >= 0);
-		seg->footer = content.substring(i) + "\r\n" + seg->footer;
-		content.remove(i);
-#if XML_PRETTY
-		content += "\r\n";
-#endif
-	};
-
 	content.setLength(0);
 	for(;;) {
 		switch(state) {
@@ -95,17 +108,21 @@ void DescriptionStream::getContent()
 		 * Closing tag is inserted at start of footer, e.g. "</root>"
 		 */
 		case State::header: {
-			XML::insertDeclaration(doc);
-			auto node = seg->item->getDescription(doc, DescType::header);
+			XmlWriter writer(content, XML_PRETTY);
+			writer.declaration();
+			seg->headerTag = seg->item->writeDescription(writer, DescType::header);
+			state = State::item;
+			if(seg->headerTag == nullptr) {
+				content.setLength(0);
+				continue;
+			}
 
-			auto ver = XML::appendNode(node, _F("specVersion"));
 			SpecVersion spec = object_->getRoot()->getSpecVersion();
-			XML::appendNode(ver, _F("major"), spec.major);
-			XML::appendNode(ver, _F("minor"), spec.minor);
-
-			XML::serialize(doc, content, XML_PRETTY);
-			splitTag(node);
-			state = State::item;
+			writer.openTag(tag_specVersion);
+			writer.field(tag_major, spec.major);
+			writer.field(tag_minor, spec.minor);
+			writer.closeTag(tag_specVersion);
+			content += "\r\n";
 			break;
 		}
 
@@ -116,13 +133,14 @@ void DescriptionStream::getContent()
 		case State::item: {
 			state = State::nextList;
 
-			auto node = seg->item->getDescription(doc, segIndex == 0 ? DescType::content : DescType::embedded);
-			if(node == nullptr) {
+			XmlWriter writer(content);
+			seg->tag = seg->item->writeDescription(writer, segIndex == 0 ? DescType::content : DescType::embedded);
+			if(seg->tag == nullptr) {
 				continue;
 			}
 
-			XML::serialize(doc, content);
-			splitTag(node);
+			writer.endStartTag();
+			content += "\r\n";
 			seg->listIndex = 0;
 			break;
 		}
@@ -135,10 +153,7 @@ void DescriptionStream::getContent()
 			seg->list = seg->item->getList(seg->listIndex, seg->listName);
 			if(seg->list == nullptr) {
 				// No more lists, emit item footer
-				if(seg->footer) {
-					content = seg->footer;
-					seg->footer = nullptr;
-				}
+				writeFooter();
 				if(segIndex == 0) {
 					// all done
 					state = State::done;
@@ -18,7 +18,9 @@
  ****/
 
 #include "include/Network/UPnP/RootDevice.h"
-#include "include/Network/UPnP/ItemEnumerator.h"
+#include "include/Network/UPnP/DeviceHost.h"
+#include "include/Network/UPnP/XmlWriter.h"
+#include "include/Network/UPnP/Hash.h"
 #include "include/Network/UPnP/DescriptionStream.h"
 #include <Network/Http/HttpConnection.h>
 #include <Network/Url.h>
@@ -35,22 +37,149 @@ UPNP_DEVICE_FIELD_MAP(XX);
 #define XX(name, req) &fn_##name,
 DEFINE_FSTR_VECTOR(fieldNames, FlashString, UPNP_DEVICE_FIELD_MAP(XX))
 #undef XX
+
+DEFINE_FSTR_LOCAL(tag_root, "root")
+DEFINE_FSTR_LOCAL(tag_device, "device")
+DEFINE_FSTR_LOCAL(attr_xmlns, "xmlns")
+DEFINE_FSTR_LOCAL(device_xmlns, "urn:schemas-upnp-org:device-1-0")
+
+/*
+ * Check Accept-Encoding for gzip, rejecting it if explicitly given a zero quality value
+ */
+bool acceptsGzip(const HttpRequest& request)
+{
+	String accept = request.headers[HTTP_HEADER_ACCEPT_ENCODING];
+	int i = accept.indexOf(_F("gzip"));
+	if(i < 0) {
+		return false;
+	}
+
+	int end = accept.indexOf(',', i);
+	String params = accept.substring(i + 4, (end < 0) ? accept.length() : end);
+	int q = params.indexOf(_F("q="));
+	return q < 0 || atof(params.c_str() + q + 2) > 0;
+}
+
+template <class CollectionType> UPnP::ItemEnumerator* getItemEnumerator(UPnP::Item* head, CollectionType* collection)
+{
+	if(collection == nullptr) {
+		return new UPnP::ItemEnumerator(head);
+	}
+
+	return new UPnP::CollectionItemEnumerator<CollectionType>(head, collection->clone());
+}
 } // namespace
 
 namespace UPnP
 {
-RootDevice* Device::getRoot()
+void Device::addDevice(Device* device)
+{
+	devices_.add(device);
+	device->parent_ = this;
+	device->setRoot(getRoot());
+	if(fieldCache) {
+		device->enableFieldCache(true);
+	}
+	if(descriptionCache) {
+		device->enableDescriptionCache(true);
+	}
+	deviceHost.deviceChanged(this);
+}
+
+void Device::addService(Service* service)
+{
+	services_.add(service);
+	service->setDevice(this);
+	if(fieldCache) {
+		service->enableFieldCache(true);
+	}
+	if(descriptionCache) {
+		service->enableDescriptionCache(true);
+	}
+	deviceHost.deviceChanged(this);
+}
+
+bool Device::removeDevice(Device* device)
+{
+	if(device == nullptr || device->parent_ != this || !devices_.remove(device)) {
+		return false;
+	}
+
+	device->parent_ = nullptr;
+	device->setRoot(nullptr);
+	deviceHost.deviceChanged(this);
+	return true;
+}
+
+bool Device::removeService(Service* service)
 {
-	assert(parent_ != nullptr);
-	Device* dev = this;
-	while(dev->parent_ != nullptr) {
-		dev = dev->parent_;
+	if(service == nullptr || service->device_ != this || !services_.remove(service)) {
+		return false;
 	}
-	return dev->getRoot();
+
+	service->setDevice(nullptr);
+	deviceHost.deviceChanged(this);
+	return true;
+}
+
+void Device::setRoot(RootDevice* root)
+{
+	root_ = root;
+	for(auto device = devices_.head(); device != nullptr; device = device->getNext()) {
+		device->setRoot(root);
+	}
+
+	auto collection = getDeviceCollection();
+	if(collection != nullptr) {
+		collection->reset();
+		for(auto device = collection->current(); device != nullptr; device = collection->next()) {
+			device->setRoot(root);
+		}
+	}
+}
+
+bool Device::validateTree()
+{
+	return validateTree(parent_, getRoot(), 0);
+}
+
+bool Device::validateTree(Device* parent, RootDevice* root, unsigned depth)
+{
+	// Guard against cycles
+	constexpr unsigned maxDepth{16};
+	if(depth > maxDepth) {
+		debug_e("[UPnP] Device %p: tree too deep, possible cycle", this);
+		return false;
+	}
+
+	bool ok{true};
+	if(parent_ != parent) {
+		debug_e("[UPnP] Device %p: parent is %p, expected %p", this, parent_, parent);
+		ok = false;
+	}
+	if(getRoot() != root) {
+		debug_e("[UPnP] Device %p: root is %p, expected %p", this, getRoot(), root);
+		ok = false;
+	}
+
+	for(auto service = services_.head(); service != nullptr; service = service->getNext()) {
+		if(service->device_ != this) {
+			debug_e("[UPnP] Service %p: device is %p, expected %p", service, service->device_, this);
+			ok = false;
+		}
+	}
+
+	for(auto device = devices_.head(); device != nullptr; device = device->getNext()) {
+		if(!device->validateTree(this, root, depth + 1)) {
+			ok = false;
+		}
+	}
+
+	return ok;
 }
 
 /*
- * Create the content. Lists are added as placeholders by DescriptionStream:
+ * Write the content. Lists are added by DescriptionStream:
  *
  * deviceList
  * iconList
@@ -58,36 +187,39 @@ RootDevice* Device::getRoot()
  * actionList
  * serviceStateTable
  *
- * The resulting JSON is rendered into XML, then emitted in chunks.
- * When a list tag is encountered, it is built via child objects.
- *
- *
+ * Content is written in chunks. When a list is encountered, it is built via child objects.
  *
  * For now, DescriptionStream 'knows' about the above lists.
  */
-XML::Node* Device::getDescription(XML::Document& doc, DescType descType)
+const FlashString* Device::writeDescription(XmlWriter& writer, DescType descType)
 {
 	switch(descType) {
-	case DescType::header: {
-		auto root = XML::appendNode(&doc, "root");
-		XML::appendAttribute(root, "xmlns", F("urn:schemas-upnp-org:device-1-0"));
-		return root;
-	}
+	case DescType::header:
+		writer.openTag(tag_root);
+		writer.attribute(attr_xmlns, device_xmlns);
+		return &tag_root;
 
 	case DescType::content:
 	case DescType::embedded: {
-		String s;
-		auto dev = XML::appendNode(&doc, "device");
+		writer.openTag(tag_device);
+		auto descriptor = getDescriptor();
 		for(unsigned i = 0; i < unsigned(Field::customStart); ++i) {
-			s = getField(Field(i));
-			if(s) {
-				XML::appendNode(dev, fieldNames[i], s);
+			// Skip absent fields, and read constant ones directly
+			if(descriptor != nullptr && !descriptor->isPresent(Field(i))) {
+				continue;
+			}
+			auto value = Descriptor::get(descriptor, Field(i));
+			if(value != nullptr) {
+				writer.field(fieldNames[i], [value](Print& p) { return p.print(*value); });
+			} else {
+				// Null values are omitted, empty ones written as empty elements
+				writer.field(fieldNames[i], getCachedField(Field(i)));
 			}
 		}
 
-		//		XML::appendNode(dev, "iconList");
+		//		writer.field("iconList", ...);
 
-		return dev;
+		return &tag_device;
 	}
 
 	default:
@@ -97,10 +229,15 @@ XML::Node* Device::getDescription(XML::Document& doc, DescType descType)
 
 String Device::getField(Field desc)
 {
+	auto value = Descriptor::get(getDescriptor(), desc);
+	if(value != nullptr) {
+		return *value;
+	}
+
 	// Provide defaults for required fields
 	switch(desc) {
 	case Field::deviceType:
-		return DeviceUrn(getField(Field::domain), getField(Field::type), getField(Field::version));
+		return DeviceUrn(getCachedField(Field::domain), getCachedField(Field::type), getCachedField(Field::version));
 	case Field::type:
 		return DeviceType::Basic;
 	case Field::friendlyName:
@@ -111,40 +248,92 @@ String Device::getField(Field desc)
 	case Field::domain:
 		return schemas_upnp_org;
 	case Field::descriptionURL: {
-		String url = getField(Field::baseURL);
+		String url = getCachedField(Field::baseURL);
 		url += _F("desc.xml");
 		return url;
 	}
 	case Field::baseURL: {
-		String url = getRoot()->getField(desc);
-		String s = getField(Field::type);
+		String url = getRoot()->getCachedField(desc);
+		String s = getCachedField(Field::type);
 		splitTypeVersion(s);
 		url += s;
 		url += '/';
 		return url;
 	}
 	case Field::serverId:
-		return (parent_ == nullptr) ? nullptr : getRoot()->getField(desc);
+		return (parent_ == nullptr) ? nullptr : getRoot()->getCachedField(desc);
 	default:
 		return nullptr;
 	}
 }
 
+String Device::getCachedField(Field desc)
+{
+	auto constValue = Descriptor::get(getDescriptor(), desc);
+	if(constValue != nullptr) {
+		return *constValue;
+	}
+
+	if(!fieldCache) {
+		return getField(desc);
+	}
+
+	String value;
+	if(!fieldCache->get(unsigned(desc), value)) {
+		value = getField(desc);
+		fieldCache->set(unsigned(desc), value);
+	}
+	return value;
+}
+
+void Device::enableFieldCache(bool enable)
+{
+	Object::enableFieldCache(enable);
+	for(auto service = services_.head(); service != nullptr; service = service->getNext()) {
+		service->enableFieldCache(enable);
+	}
+	for(auto device = devices_.head(); device != nullptr; device = device->getNext()) {
+		device->enableFieldCache(enable);
+	}
+}
+
+void Device::enableDescriptionCache(bool enable)
+{
+	Object::enableDescriptionCache(enable);
+	for(auto service = services_.head(); service != nullptr; service = service->getNext()) {
+		service->enableDescriptionCache(enable);
+	}
+	for(auto device = devices_.head(); device != nullptr; device = device->getNext()) {
+		device->enableDescriptionCache(enable);
+	}
+}
+
+void Device::invalidateFields()
+{
+	Object::invalidateFields();
+	for(auto service = services_.head(); service != nullptr; service = service->getNext()) {
+		service->invalidateFields();
+	}
+	for(auto device = devices_.head(); device != nullptr; device = device->getNext()) {
+		device->invalidateFields();
+	}
+}
+
 ItemEnumerator* Device::getList(unsigned index, String& name)
 {
 	switch(index) {
 	case 0:
 		name = F("serviceList");
-		return new ItemEnumerator(services_.head());
+		return getItemEnumerator(services_.head(), getServiceCollection());
 	case 1:
 		name = F("deviceList");
-		return new ItemEnumerator(devices_.head());
+		return getItemEnumerator(devices_.head(), getDeviceCollection());
 	default:
 		return nullptr;
 	}
 }
 
-void Device::search(const SearchFilter& filter)
+void Device::searchSelf(const SearchFilter& filter)
 {
 	switch(filter.ms.target()) {
 	case SearchTarget::all:
@@ -152,76 +341,162 @@ void Device::search(const SearchFilter& filter)
 		filter.callback(this, SearchMatch::type);
 		break;
 	case SearchTarget::type:
-		if(filter.targetString == getField(Field::deviceType)) {
+		if(matchField(Field::deviceType, filter.targetString)) {
 			filter.callback(this, SearchMatch::type);
 		}
 		break;
 	case SearchTarget::uuid:
-		if(filter.targetString == getField(Field::UDN)) {
+		if(matchField(Field::UDN, filter.targetString)) {
 			filter.callback(this, SearchMatch::uuid);
 		}
 		break;
+	case SearchTarget::root:
+		// Only root devices match
+		break;
 	default:
 		assert(false);
 	}
+}
+
+void Device::search(const SearchFilter& filter)
+{
+	searchSelf(filter);
+	if(filter.ms.target() == SearchTarget::root) {
+		return;
+	}
 
 	if(filter.ms.target() != SearchTarget::uuid) {
 		for(auto service = services_.head(); service != nullptr; service = service->getNext()) {
 			service->search(filter);
 		}
+
+		auto collection = getServiceCollection();
+		if(collection != nullptr && collection->isPersistent()) {
+			collection->reset();
+			for(auto service = collection->current(); service != nullptr; service = collection->next()) {
+				service->search(filter);
+			}
+		}
 	}
 
 	for(auto device = devices_.head(); device != nullptr; device = device->getNext()) {
 		device->search(filter);
 	}
+
+	// Re-used instances cannot be referenced by pending messages, so are not discoverable
+	auto collection = getDeviceCollection();
+	if(collection != nullptr && collection->isPersistent()) {
+		collection->reset();
+		for(auto device = collection->current(); device != nullptr; device = collection->next()) {
+			device->search(filter);
+		}
+	}
 }
 
-bool Device::formatMessage(Message& msg, MessageSpec& ms)
+size_t Device::printField(Print& p, Field desc)
+{
+	auto value = Descriptor::get(getDescriptor(), desc);
+	if(value != nullptr) {
+		return p.print(*value);
+	}
+
+	size_t count;
+	if(fieldCache && fieldCache->print(unsigned(desc), p, count)) {
+		return count;
+	}
+
+	return p.print(getCachedField(desc));
+}
+
+bool Device::matchField(Field desc, const String& value)
 {
-	msg[HTTP_HEADER_SERVER] = getField(Field::serverId);
-	msg[HTTP_HEADER_LOCATION] = getRoot()->getURL(getField(Field::descriptionURL));
+	auto constValue = Descriptor::get(getDescriptor(), desc);
+	if(constValue != nullptr) {
+		return *constValue == value;
+	}
 
-	String st;
-	String usn = getField(Field::UDN);
-	switch(ms.match()) {
+	return value == getCachedField(desc);
+}
+
+String Device::getTargetString(SearchMatch match)
+{
+	switch(match) {
 	case SearchMatch::root:
-		st = SSDP::UPNP_ROOTDEVICE;
-		usn += "::";
-		usn += st;
-		break;
+		return SSDP::UPNP_ROOTDEVICE;
 	case SearchMatch::type:
-		st = getField(Field::deviceType);
-		usn += "::";
-		usn += st;
-		break;
+		return getCachedField(Field::deviceType);
 	case SearchMatch::uuid:
-		st = getField(Field::UDN);
-		break;
+		return getCachedField(Field::UDN);
+	default:
+		return nullptr;
+	}
+}
+
+bool Device::matchTarget(SearchMatch match, const String& target)
+{
+	switch(match) {
+	case SearchMatch::root:
+		return target == SSDP::UPNP_ROOTDEVICE;
+	case SearchMatch::type:
+		return matchField(Field::deviceType, target);
+	case SearchMatch::uuid:
+		return matchField(Field::UDN, target);
 	default:
-		debug_e("[UPnP] Invalid search match value");
 		return false;
 	}
+}
 
-	if(msg.type == MessageType::notify) {
-		msg["NT"] = st;
-	} else {
-		msg["ST"] = st;
+bool Device::formatMessage(Message& msg, MessageSpec& ms)
+{
+	auto root = getRoot();
+	if(root == nullptr) {
+		// Detached from its tree
+		return false;
+	}
+
+	auto& cache = headerCache ? *headerCache : deviceHost.getHeaderCache();
+	auto localIp = RootDevice::getLocalIp(ms.remoteIp());
+	auto headers = cache.find(this, ms.match(), localIp);
+	if(headers == nullptr) {
+		String st = getTargetString(ms.match());
+		if(!st) {
+			debug_e("[UPnP] Invalid search match value");
+			return false;
+		}
+
+		String usn;
+		if(ms.match() == SearchMatch::uuid) {
+			usn = st;
+		} else {
+			usn = getCachedField(Field::UDN);
+			usn += "::";
+			usn += st;
+		}
+
+		String location = root->getLocation(getCachedField(Field::descriptionURL), localIp);
+		String serverId = getCachedField(Field::serverId);
+		headers = cache.add(this, ms.match(), localIp, serverId, location, st, usn);
+		if(headers == nullptr) {
+			HeaderCache::apply(msg, serverId.c_str(), location.c_str(), st.c_str(), usn.c_str());
+			return true;
+		}
 	}
-	msg["USN"] = usn;
+
+	headers->apply(msg);
 	return true;
 }
 
 bool Device::onHttpRequest(HttpServerConnection& connection)
 {
 	auto request = connection.getRequest();
-	if(request->uri.Path == getField(Field::descriptionURL)) {
+	if(matchField(Field::descriptionURL, request->uri.Path)) {
 		debug_i("[UPnP] Sending '%s' for '%s' to %s:%u", request->uri.Path.c_str(), getField(Field::type).c_str(),
 				connection.getRemoteIp().toString().c_str(), connection.getRemotePort());
 		auto response = connection.getResponse();
-		if(request->method == HTTP_GET) {
-			sendXml(*response, createDescription());
-		} else {
+		if(request->method != HTTP_GET) {
 			response->code = HTTP_STATUS_BAD_REQUEST;
+		} else {
+			sendDescription(connection, *this);
 		}
 		return true;
 	}
@@ -238,13 +513,63 @@ bool Device::onHttpRequest(HttpServerConnection& connection)
 		}
 	}
 
+	auto services = getServiceCollection();
+	if(services != nullptr) {
+		services->reset();
+		for(auto service = services->current(); service != nullptr; service = services->next()) {
+			if(service->onHttpRequest(connection)) {
+				return true;
+			}
+		}
+	}
+
+	auto devices = getDeviceCollection();
+	if(devices != nullptr) {
+		devices->reset();
+		for(auto device = devices->current(); device != nullptr; device = devices->next()) {
+			if(device->onHttpRequest(connection)) {
+				return true;
+			}
+		}
+	}
+
 	return false;
 }
 
+/*
+ * The encoding is chosen first so that conditional requests are checked against the variant being sent.
+ * Creating a pre-compressed stream is cheap, but the identity description may need rendering
+ * so isn't obtained until we know it's required.
+ */
+void Device::sendDescription(HttpServerConnection& connection, Object& object)
+{
+	auto& response = *connection.getResponse();
+	IDataSourceStream* stream{nullptr};
+	if(acceptsGzip(*connection.getRequest())) {
+		stream = object.createCompressedDescription();
+	}
+	bool compressed = (stream != nullptr);
+	if(compressed) {
+		response.headers[HTTP_HEADER_VARY] = _F("Accept-Encoding");
+	}
+
+	if(getRoot()->checkNotModified(connection, compressed)) {
+		delete stream;
+		return;
+	}
+
+	if(compressed) {
+		response.headers[HTTP_HEADER_CONTENT_ENCODING] = _F("gzip");
+	} else {
+		stream = object.getDescriptionStream();
+	}
+	sendXml(response, stream);
+}
+
 void Device::sendXml(HttpResponse& response, IDataSourceStream* content)
 {
 	response.headers[F("Content-Language")] = "en";
-	response.headers[HTTP_HEADER_SERVER] = getField(Device::Field::serverId);
+	response.headers[HTTP_HEADER_SERVER] = getCachedField(Device::Field::serverId);
 	response.headers[HTTP_HEADER_CONNECTION] = _F("close");
 	response.headers["EXT"] = "";
 	response.headers[F("X-User-Agent")] = F("Sming");
@@ -258,13 +583,26 @@ String toString(UPnP::Device::Field& field)
 	return fieldNames[unsigned(field)];
 }
 
+/*
+ * Field names are hashed at compile time, and a collision would produce a duplicate case label.
+ * The name is compared to confirm the match, as an unknown name could share a hash value.
+ */
 bool fromString(const char* name, UPnP::Device::Field& field)
 {
-	int i = fieldNames.indexOf(name);
-	if(i < 0) {
+	if(name == nullptr) {
 		return false;
 	}
 
-	field = UPnP::Device::Field(i);
-	return true;
+	switch(UPnP::Hash::fnv1a(name, strlen(name))) {
+#define XX(tag, req)                                                                                                   \
+	case UPnP::Hash::fnv1a(#tag):                                                                                      \
+		field = UPnP::Device::Field::tag;                                                                              \
+		break;
+		UPNP_DEVICE_FIELD_MAP(XX)
+#undef XX
+	default:
+		return false;
+	}
+
+	return fieldNames[unsigned(field)].equals(name);
 }
@@ -20,34 +20,60 @@
 #include "include/Network/UPnP/DeviceHost.h"
 #include "include/Network/UPnP/DescriptionStream.h"
 #include "include/Network/UPnP/ControlPoint.h"
+#include "include/Network/UPnP/Hash.h"
 #include <Network/SSDP/Server.h>
 #include <WMath.h>
 #include <Platform/Station.h>
+#include <Platform/System.h>
 #include <Data/Stream/MemoryDataStream.h>
 
 namespace UPnP
 {
+DeviceHost::SearchPool DeviceHost::searchPool;
 DeviceHost deviceHost;
 
+namespace
+{
+// Responses are not sent before this time so that repeated requests can be merged
+constexpr uint32_t searchResponseStartMs{100};
+// Allow for transmission time at the end of the MX window
+constexpr uint32_t searchResponseMarginMs{200};
+// Window over which notifications are spread
+constexpr uint32_t notifyStartMs{500};
+constexpr uint32_t notifyWindowMs{1000};
+// Interval between starting announcements for queued device registrations/removals
+constexpr uint32_t deviceOpIntervalMs{200};
+// How long queued searches wait for the message pool to drain
+constexpr uint32_t poolRetryMs{20};
+// Delay before first advertisement cycle starts
+constexpr uint32_t advertStartMs{1000};
+
+// Add up to +/- 25% jitter to an interval
+uint32_t jitter(uint32_t intervalMs)
+{
+	if(intervalMs < 4) {
+		return intervalMs;
+	}
+	return intervalMs - (intervalMs / 4) + (os_random() % (intervalMs / 2));
+}
+
+} // namespace
+
 /*
- * If MX is specified, wait random time before responding.
- * This should be done by the Server to space out service responses.
- * It also allows time for previous UDP packets to be sent which helps
+ * If MX is specified, responses must be sent at random times within that window.
+ * Spacing them out also allows time for previous UDP packets to be sent which helps
  * minimise transient RAM usage.
  *
- * Probably the first step is to find out how many services
- * to respond with so we can ensure all responses are sent within the
- * given time.
- *
- * Say we have 32 services (unlikely to ever be that high) with a
- * 2 second window, that gives us 62ms per response, so we'll get some
- * randomness just due to processing time.
+ * We first find out how many responses are required, then divide the window into
+ * equal slots with one response sent at a random time within each slot.
  *
- * If there's only one service then no problem.
+ * For example, 32 matches with a 2 second window gives about 56ms per response.
  *
- * Perhaps we just divide MX by the number of services and calculate a
- * random number based on that.
+ * Where there are more matches than the message pool can comfortably hold, the search is queued
+ * and each response passed to the scheduler only shortly before it's due.
  *
+ * The scheduler also limits how many messages are passed to the SSDP server at once,
+ * which bounds RAM usage and network bursts however many devices are registered.
  *
  * "For multicast M-SEARCH requests, if the search request does not contain an MX header field,
  * the device shall silently discard and ignore the search request. If the MX header field specifies
@@ -57,23 +83,22 @@ DeviceHost deviceHost;
  */
 void DeviceHost::onSearchRequest(const BasicMessage& request)
 {
-	auto mx = request["MX"];
-
-	unsigned delay = mx ? atoi(mx) : 0;
-	if(delay == 0) {
-		delay = 5;
-	} else if(delay > 5) {
-		delay = 5;
+	if(!rateLimiter.allowRequest(request.remoteIP)) {
+		debug_d("[UPnP] Search from %s dropped", request.remoteIP.toString().c_str());
+		return;
 	}
 
-	auto osrand = os_random();
-	delay = osrand / (std::numeric_limits<decltype(osrand)>::max() / 1000U / delay);
-	if(delay < 100) {
-		delay = 100;
+	auto mx = request["MX"];
+
+	unsigned mxSeconds = mx ? atoi(mx) : 0;
+	if(mxSeconds == 0) {
+		mxSeconds = 5;
+	} else if(mxSeconds > 5) {
+		mxSeconds = 5;
 	}
 
 	MessageSpec ms(MessageType::response);
-	SearchFilter filter(ms, delay);
+	SearchFilter filter(ms, searchResponseStartMs);
 
 	filter.targetString = request["ST"];
 	if(filter.targetString == SSDP::UPNP_ROOTDEVICE) {
@@ -81,9 +106,16 @@ void DeviceHost::onSearchRequest(const BasicMessage& request)
 	} else if(filter.targetString == SSDP::SSDP_ALL) {
 		ms.setTarget(SearchTarget::all);
 	} else if(filter.targetString.startsWith("urn:")) {
+		UrnRef urn(filter.targetString);
+		if(!urn) {
+			debug_w("[UPnP] Invalid URN: %s", filter.targetString.c_str());
+			return;
+		}
 		ms.setTarget(SearchTarget::type);
+		filter.targetHash = urn.hash;
 	} else if(filter.targetString.startsWith("uuid:")) {
 		ms.setTarget(SearchTarget::uuid);
+		filter.targetHash = Hash::fnv1a(filter.targetString);
 	} else {
 		debug_e("[UPnP] Invalid ST field: %s", filter.targetString.c_str());
 		return;
@@ -91,31 +123,318 @@ void DeviceHost::onSearchRequest(const BasicMessage& request)
 
 	ms.setRemote(request.remoteIP, request.remotePort);
 
-	search(filter, nullptr);
+	uint32_t windowMs = (mxSeconds * 1000U) - searchResponseStartMs - searchResponseMarginMs;
+
+	unsigned matchCount{0};
+	if(ms.target() == SearchTarget::type || ms.target() == SearchTarget::uuid) {
+		// Indexed searches are quick so are done immediately, if the message pool has room
+		updateSearchIndex();
+		filter.callback = [&](Object* object, SearchMatch match) { ++matchCount; };
+		searchIndex.search(filter);
+		if(matchCount == 0) {
+			return;
+		}
+		if(matchCount <= getPoolHeadroom()) {
+			auto scheduled = search(filter, matchCount, windowMs);
+			rateLimiter.consumeResponses(scheduled);
+			return;
+		}
+	}
+
+	// Control points often repeat a request, which is answered by the search already in progress
+	for(auto cursor = searches; cursor != nullptr; cursor = cursor->next) {
+		auto& cms = cursor->ms;
+		if(cms.type() == MessageType::response && cms.target() == ms.target() && cms.remotePort() == ms.remotePort() &&
+		   cms.remoteIp() == ms.remoteIp() && cursor->filter.targetString == filter.targetString) {
+			debug_d("[UPnP] Search from %s already in progress", request.remoteIP.toString().c_str());
+			return;
+		}
+	}
+
+	// Every root device must be visited, so spread the work over several task callbacks
+	auto cursor = new SearchCursor(ms, searchResponseStartMs);
+	if(cursor != nullptr) {
+		cursor->filter.targetString = filter.targetString;
+		cursor->filter.targetHash = filter.targetHash;
+		cursor->windowMs = windowMs;
+		cursor->matchCount = matchCount;
+		queueSearch(cursor, nullptr);
+	}
 }
 
-void DeviceHost::search(SearchFilter& filter, Device* device)
+void* DeviceHost::SearchCursor::operator new(size_t size)
 {
+	auto ptr = searchPool.allocate();
+	return (ptr == nullptr) ? ::operator new(size) : ptr;
+}
+
+void DeviceHost::SearchCursor::operator delete(void* ptr)
+{
+	if(searchPool.contains(ptr)) {
+		searchPool.release(ptr);
+	} else {
+		::operator delete(ptr);
+	}
+}
+
+/*
+ * A search covering all devices could take long enough with large numbers of devices to
+ * stall the event loop, or trigger the watchdog. The same goes for announcing a large device tree.
+ * These are therefore queued and processed one device or service at a time, for no more than
+ * `searchTimeBudget` microseconds per task callback.
+ *
+ * Registered trees are indexed, so the number of matches is usually known without a separate pass.
+ * If the caller has already counted them, `matchCount` is set.
+ */
+void DeviceHost::queueSearch(SearchCursor* cursor, Device* device)
+{
+	auto target = cursor->ms.target();
+	bool allRoots = (device == nullptr);
+	cursor->walker.begin(allRoots ? firstRootDevice() : device, allRoots, target != SearchTarget::root);
+	cursor->startTime = millis();
+
+	updateSearchIndex();
+	auto root = allRoots ? nullptr : device->getRoot();
+	if(cursor->matchCount != 0) {
+		startResponses(*cursor);
+	} else if(allRoots && target == SearchTarget::root) {
+		cursor->matchCount = rootDevices.count();
+		startResponses(*cursor);
+	} else if(allRoots && target == SearchTarget::all) {
+		cursor->matchCount = searchIndex.count() + rootDevices.count();
+		startResponses(*cursor);
+	} else if(root == device && target == SearchTarget::all && isRegistered(root)) {
+		cursor->matchCount = searchIndex.count(root) + 1;
+		startResponses(*cursor);
+	} else {
+		cursor->filter.callback = [cursor](Object* object, SearchMatch match) { ++cursor->matchCount; };
+	}
+
+	// Append to list to preserve ordering
+	if(searchTail == nullptr) {
+		searches = cursor;
+	} else {
+		searchTail->next = cursor;
+	}
+	searchTail = cursor;
+
+	if(!searchTaskQueued) {
+		searchTaskQueued = System.queueCallback(TaskDelegate(&DeviceHost::processSearches, this));
+	}
+}
+
+/*
+ * Searches waiting for their next message to fall due are passed over in favour of the others.
+ * If they're all waiting, a timer resumes processing at the earliest time one can continue.
+ */
+void DeviceHost::processSearches()
+{
+	searchTaskQueued = false;
+	searchTimer.stop();
+
+	auto startTime = micros();
+	uint32_t waitMs{UINT32_MAX};
+	bool outOfTime{false};
+	SearchCursor* prev{nullptr};
+	auto cursor = searches;
+	while(cursor != nullptr) {
+		auto wait = getSearchWait(*cursor);
+		if(wait != 0) {
+			waitMs = std::min(waitMs, wait);
+			prev = cursor;
+			cursor = cursor->next;
+			continue;
+		}
+
+		if(!continueSearch(*cursor)) {
+			auto next = cursor->next;
+			if(prev == nullptr) {
+				searches = next;
+			} else {
+				prev->next = next;
+			}
+			if(searchTail == cursor) {
+				searchTail = prev;
+			}
+			finishSearch(cursor);
+			cursor = next;
+		}
+
+		if(micros() - startTime >= searchTimeBudget) {
+			outOfTime = true;
+			break;
+		}
+	}
+
+	if(outOfTime && searches != nullptr) {
+		if(!searchTaskQueued) {
+			searchTaskQueued = System.queueCallback(TaskDelegate(&DeviceHost::processSearches, this));
+		}
+	} else if(waitMs != UINT32_MAX) {
+		searchTimer.initializeMs(waitMs, TimerDelegate(&DeviceHost::processSearches, this)).startOnce();
+	}
+}
+
+/*
+ * Changes to registered trees only mark the index as stale, so that adding many devices or services
+ * costs a single rebuild rather than one for every addition
+ */
+void DeviceHost::updateSearchIndex()
+{
+	if(searchIndexStale) {
+		searchIndex.rebuild(firstRootDevice());
+		searchIndexStale = false;
+	}
+}
+
+/*
+ * Leave some of the pool free for indexed searches and device announcements
+ */
+unsigned DeviceHost::getPoolHeadroom() const
+{
+	auto poolStats = scheduler.getPoolStats();
+	unsigned limit = poolStats.capacity * 3U / 4;
+	return (poolStats.used < limit) ? limit - poolStats.used : 0;
+}
+
+/*
+ * Messages are passed to the scheduler shortly before they're due, rather than all at once,
+ * so that large searches and announcements don't exhaust the message pool.
+ * Returns 0 if the search may continue, otherwise the time (in milliseconds) to wait.
+ */
+uint32_t DeviceHost::getSearchWait(const SearchCursor& cursor) const
+{
+	if(!cursor.counted || cursor.matchCount == 0) {
+		return 0;
+	}
+
+	if(getPoolHeadroom() == 0) {
+		return poolRetryMs;
+	}
+
+	uint32_t elapsed = millis() - cursor.startTime;
+	uint32_t slotStart = cursor.filter.delayMs + (cursor.index * cursor.slotMs);
+	uint32_t horizon = elapsed + searchLookahead;
+	return (slotStart > horizon) ? slotStart - horizon : 0;
+}
+
+/*
+ * Search the next object. If the number of matches isn't known, a first pass counts them.
+ * Returns false when the search is complete.
+ */
+bool DeviceHost::continueSearch(SearchCursor& cursor)
+{
+	if(cursor.counted && cursor.matchCount == 0) {
+		return false;
+	}
+
+	if(cursor.walker.step(cursor.filter)) {
+		return true;
+	}
+
+	if(cursor.counted || cursor.matchCount == 0) {
+		return false;
+	}
+
+	cursor.walker.restart();
+	startResponses(cursor);
+	return true;
+}
+
+/*
+ * Each message is scheduled at a random point within its own slot
+ */
+void DeviceHost::startResponses(SearchCursor& cursor)
+{
+	cursor.counted = true;
+	if(cursor.matchCount == 0) {
+		return;
+	}
+
+	cursor.slotMs = std::max(cursor.windowMs / cursor.matchCount, 1U);
+	auto c = &cursor;
+	cursor.filter.callback = [this, c](Object* object, SearchMatch match) {
+		// Allow for time already spent searching
+		uint32_t elapsed = millis() - c->startTime;
+		uint32_t delay = c->filter.delayMs + (c->index * c->slotMs) + (os_random() % c->slotMs);
+		++c->index;
+		delay = (delay > elapsed) ? delay - elapsed : 0;
+		MessageScheduler::Tag tag = (c->op == nullptr) ? 0 : c->op->id;
+		switch(scheduler.schedule(MessageSpec(c->filter.ms, match, object), delay, tag)) {
+		case MessageScheduler::Result::scheduled:
+			++c->scheduled;
+			if(c->op != nullptr) {
+				++c->op->outstanding;
+			}
+			break;
+		case MessageScheduler::Result::dropped:
+			++c->dropped;
+			break;
+		case MessageScheduler::Result::merged:
+			break;
+		}
+	};
+}
+
+void DeviceHost::finishSearch(SearchCursor* cursor)
+{
+	if(cursor->dropped != 0) {
+		debug_w("[UPnP] %u of %u messages dropped, pool full", cursor->dropped, cursor->matchCount);
+	}
+
+	if(cursor->ms.type() == MessageType::response) {
+		rateLimiter.consumeResponses(cursor->scheduled);
+	}
+
+	auto op = cursor->op;
+	auto dropped = cursor->dropped;
+	delete cursor;
+
+	if(op != nullptr) {
+		op->cursor = nullptr;
+		if(dropped != 0) {
+			op->failed = true;
+		}
+		if(op->outstanding == 0) {
+			completeDeviceOp(op);
+		}
+	}
+}
+
+unsigned DeviceHost::search(SearchFilter& filter, unsigned matchCount, uint32_t windowMs)
+{
+	// Schedule each response at a random point within its own slot
+	uint32_t slotMs = std::max(windowMs / matchCount, 1U);
+	unsigned index{0};
+	unsigned scheduled{0};
+	unsigned dropped{0};
 	filter.callback = [&](Object* object, SearchMatch match) {
-		auto item = new MessageSpec(filter.ms, match, object);
-		server.messageQueue.add(item, filter.delayMs);
-		filter.delayMs += 100;
+		uint32_t delay = filter.delayMs + (index * slotMs) + (os_random() % slotMs);
+		++index;
+		switch(scheduler.schedule(MessageSpec(filter.ms, match, object), delay)) {
+		case MessageScheduler::Result::scheduled:
+			++scheduled;
+			break;
+		case MessageScheduler::Result::dropped:
+			++dropped;
+			break;
+		case MessageScheduler::Result::merged:
+			break;
+		}
 	};
 
 #if DEBUG_VERBOSE_LEVEL == DBG
-	unsigned initialCount = server.messageQueue.count();
+	unsigned initialCount = scheduler.count();
 #endif
 
-	if(device == nullptr) {
-		for(auto dev = deviceHost.firstRootDevice(); dev != nullptr; dev = dev->getNext()) {
-			dev->search(filter);
-		}
-	} else {
-		device->search(filter);
+	searchIndex.search(filter);
+
+	if(dropped != 0) {
+		debug_w("[UPnP] %u of %u messages dropped, pool full", dropped, matchCount);
 	}
 
 #if DEBUG_VERBOSE_LEVEL == DBG
-	unsigned count = server.messageQueue.count();
+	unsigned count = scheduler.count();
 	String s = toString(filter.ms.type());
 	if(!s) {
 		s = _F("**BAD**  ");
@@ -141,19 +460,72 @@ void DeviceHost::search(SearchFilter& filter, Device* device)
 
 	m_puts(s.c_str());
 #endif
+
+	return scheduled;
+}
+
+bool DeviceHost::notify(Device* device, NotifySubtype subtype)
+{
+	return queueNotify(device, subtype) != nullptr;
 }
 
-void DeviceHost::notify(Device* device, NotifySubtype subtype)
+DeviceHost::SearchCursor* DeviceHost::queueNotify(Device* device, NotifySubtype subtype)
 {
+	if(device == nullptr) {
+		return nullptr;
+	}
+
 	MessageSpec ms(subtype, SearchTarget::all);
 	ms.setRemote(SSDP_MULTICAST_IP, SSDP_MULTICAST_PORT);
-	SearchFilter filter(ms, 500);
-	search(filter, device);
+	auto cursor = new SearchCursor(ms, notifyStartMs);
+	if(cursor != nullptr) {
+		cursor->windowMs = notifyWindowMs;
+		queueSearch(cursor, device);
+	}
+	return cursor;
+}
+
+/*
+ * Devices must re-send advertisements before their CACHE-CONTROL max-age expires,
+ * otherwise control points will drop them. Root devices are announced one at a time,
+ * spaced evenly across the advertisement interval with some jitter, so that even a large
+ * number of root devices never produces a multicast storm.
+ * Each announcement is further spread out by the scheduler.
+ */
+void DeviceHost::scheduleAdvertisement(uint32_t delayMs)
+{
+	advertTimer.initializeMs(std::max(delayMs, 1U), TimerDelegate(&DeviceHost::onAdvertTimer, this)).startOnce();
+}
+
+void DeviceHost::onAdvertTimer()
+{
+	unsigned rootCount{0};
+	RootDevice* root{nullptr};
+	for(auto dev = firstRootDevice(); dev != nullptr; dev = dev->getNext()) {
+		if(rootCount == advertIndex) {
+			root = dev;
+		}
+		++rootCount;
+	}
+
+	if(root == nullptr) {
+		// End of list, or devices have been removed
+		advertIndex = 0;
+		root = firstRootDevice();
+	}
+
+	if(root != nullptr) {
+		notify(root, NotifySubtype::alive);
+		++advertIndex;
+	}
+
+	uint32_t intervalMs = UPNP_ADVERTISE_INTERVAL * 1000U / std::max(rootCount, 1U);
+	scheduleAdvertisement(jitter(intervalMs));
 }
 
 bool DeviceHost::begin()
 {
-	return SSDP::server.begin(
+	bool ok = SSDP::server.begin(
 		[this](BasicMessage& msg) {
 			if(msg.type == MessageType::msearch) {
 				onSearchRequest(msg);
@@ -163,7 +535,12 @@ bool DeviceHost::begin()
 				}
 			}
 		},
-		[](Message& msg, MessageSpec& ms) {
+		[this](Message& msg, MessageSpec& ms) {
+			MessageScheduler::Tag tag;
+			if(!scheduler.confirmSend(ms, tag)) {
+				// Object removed after message was passed to the server
+				return;
+			}
 			auto object = ms.object<Object>();
 			if(object == nullptr) {
 				// Send directly
@@ -171,13 +548,41 @@ bool DeviceHost::begin()
 				server.sendMessage(msg);
 			} else {
 				object->sendMessage(msg, ms);
+				messageSent(tag);
 			}
 		});
+
+	if(ok) {
+		advertIndex = 0;
+		scheduleAdvertisement(jitter(advertStartMs));
+	}
+
+	return ok;
 }
 
 void DeviceHost::end()
 {
+	advertTimer.stop();
+	deviceOpTimer.stop();
+	searchTimer.stop();
+	scheduler.clear();
 	SSDP::server.end();
+
+	while(searches != nullptr) {
+		auto next = searches->next;
+		delete searches;
+		searches = next;
+	}
+	searchTail = nullptr;
+	for(auto op = deviceOps; op != nullptr; op = op->next) {
+		op->cursor = nullptr;
+		op->failed = true;
+	}
+
+	// Nothing further will be sent
+	while(deviceOps != nullptr) {
+		completeDeviceOp(deviceOps);
+	}
 }
 
 bool DeviceHost::isActive() const
@@ -185,35 +590,292 @@ bool DeviceHost::isActive() const
 	return SSDP::server.isActive();
 }
 
-bool DeviceHost::registerDevice(RootDevice* device)
+bool DeviceHost::isRegistered(const RootDevice* device)
 {
-	if(!rootDevices.add(device)) {
+	return rootDevices.contains(device);
+}
+
+bool DeviceHost::registerDevice(RootDevice* device, DeviceCallback callback)
+{
+	if(device == nullptr) {
 		return false;
 	}
 
-	if(isActive()) {
-		// TODO: If device already registered we should return true but not advertise
-		notify(device, NotifySubtype::alive);
+	if(isRegistered(device)) {
+		// Already advertised
+		if(callback) {
+			callback(*device, true, true);
+		}
+		return true;
+	}
+
+	if(!rootDevices.add(device)) {
+		return false;
 	}
 
+	searchIndexStale = true;
+	queueDeviceOp(device, NotifySubtype::alive, callback);
 	return true;
 }
 
-bool DeviceHost::unRegisterDevice(RootDevice* device)
+bool DeviceHost::unRegisterDevice(RootDevice* device, DeviceCallback callback)
 {
-	if(!rootDevices.remove(device)) {
+	if(!isRegistered(device)) {
 		// Device wasn't running
 		return false;
 	}
 
-	if(isActive()) {
-		notify(device, NotifySubtype::byebye);
+	// Searches in progress continue with the next device
+	for(auto cursor = searches; cursor != nullptr; cursor = cursor->next) {
+		cursor->walker.removed(device);
+	}
+
+	rootDevices.remove(device);
+	searchIndex.remove(device);
+	headerCache.clear();
+
+	/*
+	 * Drop anything still waiting to be sent for this device, including any 'ssdp:alive' announcements.
+	 * Messages already passed to the SSDP server are cancelled.
+	 */
+	scheduler.remove([device](const MessageSpec& ms, MessageScheduler::Tag) {
+		auto object = ms.object<Object>();
+		return object != nullptr && object->getRoot() == device;
+	});
+
+	// Any announcements still in progress are abandoned
+	for(auto op = deviceOps; op != nullptr;) {
+		auto next = op->next;
+		if(op->device == device) {
+			op->failed = true;
+			completeDeviceOp(op);
+		}
+		op = next;
+	}
+
+	queueDeviceOp(device, NotifySubtype::byebye, callback);
+	return true;
+}
+
+unsigned DeviceHost::registerDevices(RootDevice* const* devices, unsigned count, DeviceCallback callback)
+{
+	unsigned n{0};
+	for(unsigned i = 0; i < count; ++i) {
+		if(registerDevice(devices[i], callback)) {
+			++n;
+		}
+	}
+	return n;
+}
+
+unsigned DeviceHost::unRegisterDevices(RootDevice* const* devices, unsigned count, DeviceCallback callback)
+{
+	unsigned n{0};
+	for(unsigned i = 0; i < count; ++i) {
+		if(unRegisterDevice(devices[i], callback)) {
+			++n;
+		}
+	}
+	return n;
+}
+
+/*
+ * Device registration and removal is queued so that announcements for large numbers of devices
+ * are paced: one device is started per tick, and only when the message pool has room.
+ * Each operation is complete when all its messages have been sent by the SSDP server,
+ * or have been dropped, in which case the callback reports failure.
+ */
+bool DeviceHost::queueDeviceOp(RootDevice* device, NotifySubtype subtype, DeviceCallback callback)
+{
+	// Tags identify the messages belonging to each operation, 0 is reserved for untagged messages
+	if(++lastOpId == 0) {
+		lastOpId = 1;
+	}
+	auto op = new DeviceOp{nullptr, device, callback, subtype, nullptr, lastOpId, 0, false, false};
+	if(op == nullptr) {
+		if(callback) {
+			callback(*device, subtype != NotifySubtype::byebye, false);
+		}
+		return false;
+	}
+
+	// Append to list to preserve ordering
+	if(deviceOpTail == nullptr) {
+		deviceOps = op;
+	} else {
+		deviceOpTail->next = op;
+	}
+	deviceOpTail = op;
+
+	if(!isActive()) {
+		// Nothing to send
+		completeDeviceOp(op);
+		return true;
+	}
+
+	if(!deviceOpTimer.isStarted()) {
+		deviceOpTimer.initializeMs(deviceOpIntervalMs, TimerDelegate(&DeviceHost::processDeviceOps, this)).start();
 	}
 
-	// TODO: When last notification has been sent, inform application
 	return true;
 }
 
+void DeviceHost::processDeviceOps()
+{
+	DeviceOp* op = deviceOps;
+	while(op != nullptr && op->active) {
+		op = op->next;
+	}
+
+	if(op == nullptr) {
+		// Nothing left to start; active operations complete as messages are sent
+		deviceOpTimer.stop();
+		return;
+	}
+
+	auto poolStats = scheduler.getPoolStats();
+	if(poolStats.used * 2 >= poolStats.capacity) {
+		// Wait for scheduler to drain
+		return;
+	}
+
+	op->active = true;
+	op->cursor = queueNotify(op->device, op->subtype);
+	if(op->cursor == nullptr) {
+		op->failed = true;
+		completeDeviceOp(op);
+		return;
+	}
+	op->cursor->op = op;
+}
+
+void DeviceHost::completeDeviceOp(DeviceOp* op)
+{
+	// Unlink
+	DeviceOp* prev{nullptr};
+	if(deviceOps == op) {
+		deviceOps = op->next;
+	} else {
+		for(prev = deviceOps; prev != nullptr; prev = prev->next) {
+			if(prev->next == op) {
+				prev->next = op->next;
+				break;
+			}
+		}
+	}
+	if(deviceOpTail == op) {
+		deviceOpTail = prev;
+	}
+
+	// Any announcements not yet scheduled continue, but are no longer tracked
+	if(op->cursor != nullptr) {
+		op->cursor->op = nullptr;
+	}
+
+	if(op->subtype == NotifySubtype::byebye) {
+		// Device may now be destroyed
+		headerCache.clear();
+	}
+
+	if(op->callback) {
+		op->callback(*op->device, op->subtype != NotifySubtype::byebye, !op->failed);
+	}
+
+	delete op;
+}
+
+/*
+ * Messages are tagged with the operation they belong to, so periodic advertisements
+ * and other notifications for the same device aren't counted against it
+ */
+DeviceHost::DeviceOp* DeviceHost::findDeviceOp(MessageScheduler::Tag tag)
+{
+	for(auto op = deviceOps; op != nullptr; op = op->next) {
+		if(op->id == tag) {
+			return op;
+		}
+	}
+	return nullptr;
+}
+
+void DeviceHost::messageSent(MessageScheduler::Tag tag)
+{
+	auto op = findDeviceOp(tag);
+	if(op == nullptr) {
+		return;
+	}
+
+	if(op->outstanding > 0 && --op->outstanding == 0 && op->cursor == nullptr) {
+		completeDeviceOp(op);
+	}
+}
+
+/*
+ * Announcements removed from the scheduler will never be sent, so stop waiting for them
+ */
+void DeviceHost::messageDropped(MessageScheduler::Tag tag)
+{
+	auto op = findDeviceOp(tag);
+	if(op == nullptr) {
+		return;
+	}
+
+	op->failed = true;
+	messageSent(tag);
+}
+
+void DeviceHost::deviceChanged(Device* device)
+{
+	if(device == nullptr) {
+		return;
+	}
+
+	headerCache.clear();
+
+	// Objects detached from their root device can no longer send messages
+	scheduler.remove([this](const MessageSpec& ms, MessageScheduler::Tag tag) {
+		auto object = ms.object<Object>();
+		if(object == nullptr || object->getRoot() != nullptr) {
+			return false;
+		}
+		if(tag != 0) {
+			messageDropped(tag);
+		}
+		return true;
+	});
+
+	// Trees not yet attached to a root device are dealt with when they are added
+	auto root = device->getRoot();
+	if(root == nullptr) {
+		return;
+	}
+
+	root->invalidateFields();
+
+	/*
+	 * Pointers held by searches in progress may no longer be valid, so walk again from the start.
+	 * Messages already pending are merged by the scheduler; those already sent are repeated.
+	 * Responses re-use their original slots.
+	 */
+	for(auto cursor = searches; cursor != nullptr; cursor = cursor->next) {
+		if(cursor->walker.getTreeRoot() != root) {
+			continue;
+		}
+		cursor->walker.restart();
+		if(cursor->counted) {
+			cursor->index = 0;
+		} else {
+			cursor->matchCount = 0;
+		}
+	}
+
+	// Only registered trees are indexed
+	root->descriptionChanged();
+	if(isRegistered(root)) {
+		searchIndexStale = true;
+	}
+}
+
 bool DeviceHost::onHttpRequest(HttpServerConnection& connection)
 {
 	// Block access from remote networks, or if connected via AP
@@ -0,0 +1,132 @@
+/**
+ * FieldCache.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/FieldCache.h"
+#include <stdlib.h>
+
+namespace UPnP
+{
+const char* FieldCache::find(unsigned index) const
+{
+	for(unsigned pos = 0; pos < length;) {
+		unsigned i = uint8_t(data[pos++]);
+		auto s = &data[pos];
+		if(i == index) {
+			return s;
+		}
+		pos += strlen(s) + 1;
+	}
+
+	return nullptr;
+}
+
+bool FieldCache::get(unsigned index, String& value) const
+{
+	if(index >= 32) {
+		return false;
+	}
+
+	uint32_t mask = 1U << index;
+	if((cached & mask) == 0) {
+		return false;
+	}
+
+	if(nulls & mask) {
+		value = nullptr;
+		return true;
+	}
+
+	auto s = find(index);
+	if(s == nullptr) {
+		return false;
+	}
+
+	value = s;
+	return true;
+}
+
+bool FieldCache::print(unsigned index, Print& p, size_t& count) const
+{
+	if(index >= 32) {
+		return false;
+	}
+
+	uint32_t mask = 1U << index;
+	if((cached & mask) == 0) {
+		return false;
+	}
+
+	if(nulls & mask) {
+		count = 0;
+		return true;
+	}
+
+	auto s = find(index);
+	if(s == nullptr) {
+		return false;
+	}
+
+	count = p.print(s);
+	return true;
+}
+
+void FieldCache::set(unsigned index, const String& value)
+{
+	if(index >= 32) {
+		return;
+	}
+
+	uint32_t mask = 1U << index;
+	if(cached & mask) {
+		// Values are only added, never replaced
+		return;
+	}
+
+	if(!value) {
+		cached |= mask;
+		nulls |= mask;
+		return;
+	}
+
+	unsigned newLength = length + 1 + value.length() + 1;
+	if(newLength > 0xffff) {
+		return;
+	}
+	auto newData = static_cast<char*>(realloc(data, newLength));
+	if(newData == nullptr) {
+		return;
+	}
+
+	data = newData;
+	data[length] = char(index);
+	memcpy(&data[length + 1], value.c_str(), value.length() + 1);
+	length = newLength;
+	cached |= mask;
+}
+
+void FieldCache::clear()
+{
+	free(data);
+	data = nullptr;
+	length = 0;
+	cached = 0;
+	nulls = 0;
+}
+
+} // namespace UPnP
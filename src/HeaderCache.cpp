@@ -0,0 +1,107 @@
+/**
+ * HeaderCache.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/HeaderCache.h"
+
+namespace UPnP
+{
+void HeaderCache::Entry::apply(Message& msg) const
+{
+	HeaderCache::apply(msg, value(0), value(1), value(2), value(3));
+}
+
+void HeaderCache::apply(Message& msg, const char* server, const char* location, const char* st, const char* usn)
+{
+	msg[HTTP_HEADER_SERVER] = server;
+	msg[HTTP_HEADER_LOCATION] = location;
+	if(msg.type == MessageType::notify) {
+		msg["NT"] = st;
+	} else {
+		msg["ST"] = st;
+	}
+	msg["USN"] = usn;
+}
+
+const HeaderCache::Entry* HeaderCache::find(Object* object, SearchMatch match, IpAddress localIp)
+{
+	for(auto e = head; e != nullptr; e = e->next) {
+		if(e->object == object && e->match == match && e->localIp == localIp) {
+			e->lastUsed = ++useCount;
+			return e;
+		}
+	}
+
+	return nullptr;
+}
+
+const HeaderCache::Entry* HeaderCache::add(Object* object, SearchMatch match, IpAddress localIp,
+										   const String& server, const String& location, const String& st,
+										   const String& usn)
+{
+	Entry* entry{nullptr};
+	if(count < maxEntries) {
+		entry = new Entry;
+	}
+	if(entry != nullptr) {
+		entry->next = head;
+		head = entry;
+		++count;
+	} else if(head == nullptr) {
+		return nullptr;
+	} else {
+		// Replace least-recently used entry
+		entry = head;
+		for(auto e = head; e != nullptr; e = e->next) {
+			if(int32_t(e->lastUsed - entry->lastUsed) < 0) {
+				entry = e;
+			}
+		}
+	}
+
+	entry->object = object;
+	entry->match = match;
+	entry->localIp = localIp;
+	entry->lastUsed = ++useCount;
+	auto& values = entry->values;
+	values.setLength(0);
+	values.reserve(server.length() + location.length() + st.length() + usn.length() + 3);
+	values += server;
+	values += '\0';
+	entry->offsets[0] = values.length();
+	values += location;
+	values += '\0';
+	entry->offsets[1] = values.length();
+	values += st;
+	values += '\0';
+	entry->offsets[2] = values.length();
+	values += usn;
+	return entry;
+}
+
+void HeaderCache::clear()
+{
+	while(head != nullptr) {
+		auto next = head->next;
+		delete head;
+		head = next;
+	}
+	count = 0;
+}
+
+} // namespace UPnP
@@ -0,0 +1,62 @@
+/**
+ * ItemEnumerator.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/Collection.h"
+
+#ifndef UPNP_ENUMERATOR_POOL_SIZE
+#define UPNP_ENUMERATOR_POOL_SIZE 8
+#endif
+
+namespace
+{
+// Slots are sized for the largest enumerator type
+using Pool = UPnP::ObjectPool<UPnP::CollectionItemEnumerator<UPnP::DeviceCollection>, UPNP_ENUMERATOR_POOL_SIZE>;
+Pool pool;
+
+} // namespace
+
+namespace UPnP
+{
+void* ItemEnumerator::operator new(size_t size)
+{
+	if(size <= sizeof(CollectionItemEnumerator<DeviceCollection>)) {
+		auto ptr = pool.allocate();
+		if(ptr != nullptr) {
+			return ptr;
+		}
+	}
+
+	return ::operator new(size);
+}
+
+void ItemEnumerator::operator delete(void* ptr)
+{
+	if(pool.contains(ptr)) {
+		pool.release(ptr);
+	} else {
+		::operator delete(ptr);
+	}
+}
+
+ObjectPoolStats ItemEnumerator::getPoolStats()
+{
+	return pool.getStats();
+}
+
+} // namespace UPnP
@@ -27,47 +27,69 @@ bool LinkedItemList::add(LinkedItem* item)
 		return false;
 	}
 
-	LinkedItem* prev = nullptr;
-	auto it = head_;
-	while(it != nullptr) {
-		if(it == item) {
-			// Already in list
-			return true;
-		}
-		prev = it;
-		it = it->next_;
+	if(item->owner_ == this) {
+		// Already in list
+		return true;
+	}
+
+	if(item->owner_ != nullptr) {
+		debug_e("[UPnP] Item %p already in another list", item);
+		return false;
 	}
 
-	if(prev == nullptr) {
+	item->owner_ = this;
+	item->next_ = nullptr;
+	item->prev_ = tail_;
+	if(tail_ == nullptr) {
 		head_ = item;
 	} else {
-		prev->next_ = item;
+		tail_->next_ = item;
 	}
-	item->next_ = it;
+	tail_ = item;
+	++count_;
 	return true;
 }
 
 bool LinkedItemList::remove(LinkedItem* item)
 {
-	if(item == nullptr) {
+	if(!contains(item)) {
 		return false;
 	}
 
-	if(head_ == item) {
+	if(item->prev_ == nullptr) {
 		head_ = item->next_;
-		return true;
+	} else {
+		item->prev_->next_ = item->next_;
 	}
 
-	auto it = head_;
-	while(it->next_ != nullptr) {
-		if(it->next_ == item) {
-			it->next_ = item->next_;
-			break;
-		}
-		it = it->next_;
+	if(item->next_ == nullptr) {
+		tail_ = item->prev_;
+	} else {
+		item->next_->prev_ = item->prev_;
 	}
+
 	item->next_ = nullptr;
+	item->prev_ = nullptr;
+	item->owner_ = nullptr;
+	--count_;
 	return true;
 }
 
+void LinkedItemList::clear()
+{
+	// A copied list refers to items it doesn't own, so leave those alone
+	auto item = head_;
+	while(item != nullptr && item->owner_ == this) {
+		auto next = item->next_;
+		item->next_ = nullptr;
+		item->prev_ = nullptr;
+		item->owner_ = nullptr;
+		item = next;
+	}
+
+	head_ = nullptr;
+	tail_ = nullptr;
+	count_ = 0;
+}
+
 } // namespace UPnP
@@ -0,0 +1,278 @@
+/**
+ * MessageScheduler.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/MessageScheduler.h"
+#include <Network/SSDP/Server.h>
+
+#ifndef UPNP_MAX_INFLIGHT
+#define UPNP_MAX_INFLIGHT 4
+#endif
+
+namespace
+{
+// Retry interval when SSDP server queue is full
+constexpr uint32_t busyRetryMs{20};
+
+// Compare millisecond times, allowing for wrap
+bool isDue(uint32_t due, uint32_t now)
+{
+	return int32_t(due - now) <= 0;
+}
+
+} // namespace
+
+namespace UPnP
+{
+MessageScheduler::MessageScheduler() : maxInFlight(UPNP_MAX_INFLIGHT)
+{
+}
+
+MessageScheduler::Result MessageScheduler::schedule(const MessageSpec& spec, uint32_t delayMs, Tag tag)
+{
+	auto due = millis() + delayMs;
+
+	auto dup = findDuplicate(spec);
+	if(dup != nullptr) {
+		// Merge: the pending response satisfies both requests, so just make sure it goes out no later than required
+		if(int32_t(due - dup->due) < 0) {
+			dup->due = due;
+			// Entry can only move towards the head, so search back from where it is now
+			auto prev = dup->prev;
+			unlink(dup);
+			while(prev != nullptr && !isDue(prev->due, due)) {
+				prev = prev->prev;
+			}
+			insertAfter(prev, dup);
+			startTimer();
+		}
+		++stats.suppressed;
+		return Result::merged;
+	}
+
+	auto entry = pool.create(spec, due, tag);
+	if(entry == nullptr) {
+		debug_w("[UPnP] Message pool exhausted, discarding");
+		++stats.dropped;
+		return Result::dropped;
+	}
+	insert(entry);
+	++stats.scheduled;
+	startTimer();
+	return Result::scheduled;
+}
+
+void MessageScheduler::clear()
+{
+	timer.stop();
+	while(head != nullptr) {
+		auto next = head->next;
+		pool.destroy(head);
+		head = next;
+	}
+	tail = nullptr;
+	count_ = 0;
+
+	while(inFlight != nullptr) {
+		auto next = inFlight->next;
+		pool.destroy(inFlight);
+		inFlight = next;
+	}
+}
+
+unsigned MessageScheduler::remove(Predicate predicate)
+{
+	unsigned removed{0};
+	auto entry = head;
+	while(entry != nullptr) {
+		auto next = entry->next;
+		if(predicate(entry->spec, entry->tag)) {
+			unlink(entry);
+			pool.destroy(entry);
+			++removed;
+		}
+		entry = next;
+	}
+
+	if(removed != 0) {
+		startTimer();
+	}
+
+	// Objects for cancelled messages may already have been destroyed, so don't check those again
+	for(auto e = inFlight; e != nullptr; e = e->next) {
+		if(!e->cancelled && predicate(e->spec, e->tag)) {
+			e->cancelled = true;
+			++removed;
+		}
+	}
+
+	return removed;
+}
+
+bool MessageScheduler::confirmSend(const MessageSpec& spec, Tag& tag)
+{
+	tag = 0;
+	Entry* prev{nullptr};
+	for(auto e = inFlight; e != nullptr; prev = e, e = e->next) {
+		if(e->sent != &spec) {
+			continue;
+		}
+		if(prev == nullptr) {
+			inFlight = e->next;
+		} else {
+			prev->next = e->next;
+		}
+		tag = e->tag;
+		bool cancelled = e->cancelled;
+		pool.destroy(e);
+		return !cancelled;
+	}
+
+	// Not one of ours
+	return true;
+}
+
+/*
+ * The server deletes a spec once it's been sent, so a record with the same address must be out of date
+ */
+void MessageScheduler::releaseInFlight(const MessageSpec* sent)
+{
+	Entry* prev{nullptr};
+	for(auto e = inFlight; e != nullptr; prev = e, e = e->next) {
+		if(e->sent == sent) {
+			if(prev == nullptr) {
+				inFlight = e->next;
+			} else {
+				prev->next = e->next;
+			}
+			pool.destroy(e);
+			return;
+		}
+	}
+}
+
+MessageScheduler::Entry* MessageScheduler::findDuplicate(const MessageSpec& spec)
+{
+	// Only search responses are merged; notifications are always sent
+	if(spec.type() != MessageType::response) {
+		return nullptr;
+	}
+
+	for(auto e = head; e != nullptr; e = e->next) {
+		auto& ms = e->spec;
+		if(ms.type() == MessageType::response && ms.match() == spec.match() &&
+		   ms.object<void>() == spec.object<void>() && ms.remotePort() == spec.remotePort() &&
+		   ms.remoteIp() == spec.remoteIp()) {
+			return e;
+		}
+	}
+
+	return nullptr;
+}
+
+void MessageScheduler::insert(Entry* entry)
+{
+	// Keep list in order of due time, preserving order of entries with the same time
+	auto prev = tail;
+	while(prev != nullptr && !isDue(prev->due, entry->due)) {
+		prev = prev->prev;
+	}
+	insertAfter(prev, entry);
+}
+
+void MessageScheduler::insertAfter(Entry* prev, Entry* entry)
+{
+	entry->prev = prev;
+	if(prev == nullptr) {
+		entry->next = head;
+		head = entry;
+	} else {
+		entry->next = prev->next;
+		prev->next = entry;
+	}
+
+	if(entry->next == nullptr) {
+		tail = entry;
+	} else {
+		entry->next->prev = entry;
+	}
+	++count_;
+}
+
+void MessageScheduler::unlink(Entry* entry)
+{
+	if(entry->prev == nullptr) {
+		head = entry->next;
+	} else {
+		entry->prev->next = entry->next;
+	}
+
+	if(entry->next == nullptr) {
+		tail = entry->prev;
+	} else {
+		entry->next->prev = entry->prev;
+	}
+
+	entry->next = entry->prev = nullptr;
+	--count_;
+}
+
+void MessageScheduler::startTimer()
+{
+	timer.stop();
+	if(head == nullptr) {
+		return;
+	}
+
+	auto now = millis();
+	uint32_t delay = isDue(head->due, now) ? 0 : head->due - now;
+	timer.initializeMs(delay ?: 1, TimerDelegate(&MessageScheduler::onTimer, this)).startOnce();
+}
+
+void MessageScheduler::onTimer()
+{
+	auto now = millis();
+	while(head != nullptr && isDue(head->due, now)) {
+		if(server.messageQueue.count() >= maxInFlight) {
+			// Let the server catch up
+			timer.initializeMs(busyRetryMs, TimerDelegate(&MessageScheduler::onTimer, this)).startOnce();
+			return;
+		}
+
+		auto entry = head;
+		unlink(entry);
+		/*
+		 * The SSDP queue takes ownership of the spec and deletes it once sent, using the global allocator.
+		 * Copies therefore can't come from the pool, but no more than `maxInFlight` exist at once.
+		 */
+		auto spec = new MessageSpec(entry->spec);
+		if(spec == nullptr) {
+			pool.destroy(entry);
+			continue;
+		}
+		releaseInFlight(spec);
+		entry->sent = spec;
+		entry->next = inFlight;
+		inFlight = entry;
+		server.messageQueue.add(spec, 0);
+	}
+
+	startTimer();
+}
+
+} // namespace UPnP
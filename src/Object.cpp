@@ -51,9 +51,65 @@ void Object::sendMessage(Message& msg, MessageSpec& ms)
 	}
 }
 
+void Object::enableFieldCache(bool enable)
+{
+	if(!enable) {
+		fieldCache.reset();
+		headerCache.reset();
+	} else if(!fieldCache) {
+		fieldCache.reset(new FieldCache);
+		// Devices have up to three search matches, services just one
+		headerCache.reset(new HeaderCache(3 * UPNP_URL_CACHE_SIZE));
+	}
+}
+
+void Object::invalidateFields()
+{
+	if(fieldCache) {
+		fieldCache->clear();
+	}
+	if(headerCache) {
+		headerCache->clear();
+	}
+}
+
 IDataSourceStream* Object::createDescription()
 {
 	return new DescriptionStream(this);
 }
 
+void Object::enableDescriptionCache(bool enable)
+{
+	if(!enable) {
+		descriptionCache.reset();
+	} else if(!descriptionCache) {
+		descriptionCache.reset(new DescriptionCache(this));
+	}
+}
+
+IDataSourceStream* Object::getDescriptionStream()
+{
+	auto root = getRoot();
+	if(!descriptionCache || root == nullptr) {
+		return createDescription();
+	}
+
+	auto version = root->getDescriptionVersion();
+	auto stream = descriptionCache->getStream(version);
+	if(stream != nullptr) {
+		return stream;
+	}
+
+	std::unique_ptr<IDataSourceStream> source(createDescription());
+	if(source && descriptionCache->update(*source, version)) {
+		stream = descriptionCache->getStream(version);
+		if(stream != nullptr) {
+			return stream;
+		}
+	}
+
+	// Source has been consumed so start again
+	return createDescription();
+}
+
 } // namespace UPnP
@@ -0,0 +1,115 @@
+/**
+ * RateLimiter.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/RateLimiter.h"
+#include <WString.h>
+#include <algorithm>
+
+namespace
+{
+constexpr int32_t tokenScale{1000};
+
+// Defaults allow a control point to repeat a search a couple of times
+constexpr UPnP::RateLimiter::Config defaultConfig{2, 5, 50, 200};
+
+} // namespace
+
+namespace UPnP
+{
+void RateLimiter::Bucket::refill(uint32_t now, uint16_t rate, uint16_t burst)
+{
+	uint32_t elapsed = now - lastUpdate;
+	lastUpdate = now;
+	int64_t newTokens = tokens + int64_t(elapsed) * rate;
+	tokens = std::min(newTokens, int64_t(burst) * tokenScale);
+}
+
+RateLimiter::RateLimiter()
+{
+	configure(defaultConfig);
+}
+
+void RateLimiter::configure(const Config& config)
+{
+	this->config = config;
+	responses.tokens = int32_t(config.responseBurst) * tokenScale;
+	responses.lastUpdate = millis();
+	for(auto& src : sources) {
+		src.ip = IpAddress();
+	}
+}
+
+RateLimiter::Source* RateLimiter::findSource(IpAddress ip, uint32_t now)
+{
+	// Look for existing entry, otherwise replace the one which has been idle longest
+	Source* oldest = &sources[0];
+	for(auto& src : sources) {
+		if(src.ip == ip) {
+			return &src;
+		}
+		if(int32_t(src.bucket.lastUpdate - oldest->bucket.lastUpdate) < 0 || src.ip.isNull()) {
+			oldest = &src;
+		}
+	}
+
+	oldest->ip = ip;
+	oldest->bucket.tokens = int32_t(config.sourceBurst) * tokenScale;
+	oldest->bucket.lastUpdate = now;
+	return oldest;
+}
+
+bool RateLimiter::allowRequest(IpAddress remoteIp)
+{
+	if(!enabled) {
+		++stats.accepted;
+		return true;
+	}
+
+	auto now = millis();
+
+	responses.refill(now, config.responseRate, config.responseBurst);
+	if(responses.tokens <= 0) {
+		++stats.droppedGlobal;
+		return false;
+	}
+
+	auto src = findSource(remoteIp, now);
+	src->bucket.refill(now, config.sourceRate, config.sourceBurst);
+	if(src->bucket.tokens < tokenScale) {
+		++stats.droppedSource;
+		return false;
+	}
+
+	src->bucket.tokens -= tokenScale;
+	++stats.accepted;
+	return true;
+}
+
+void RateLimiter::consumeResponses(unsigned count)
+{
+	if(!enabled) {
+		return;
+	}
+
+	// Budget may go negative, in which case requests are dropped until it recovers
+	int32_t limit = int32_t(config.responseBurst) * tokenScale;
+	responses.tokens -= int32_t(std::min(count * unsigned(tokenScale), unsigned(limit) * 2));
+}
+
+} // namespace UPnP
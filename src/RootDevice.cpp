@@ -21,7 +21,11 @@
 #include <Network/SSDP/Server.h>
 #include <FlashString/TemplateStream.hpp>
 #include <Platform/Station.h>
+#include <Platform/AccessPoint.h>
 #include <SmingVersion.h>
+#include <SystemClock.h>
+#include <DateTime.h>
+#include <WMath.h>
 
 IMPORT_FSTR(upnp_default_page, COMPONENT_PATH "/resource/default.html");
 
@@ -29,16 +33,129 @@ namespace UPnP
 {
 DEFINE_FSTR_LOCAL(defaultPresentationURL, "index.html");
 
+namespace
+{
+// Changes on every restart, so validators issued by previous firmware or state are never matched
+uint32_t bootId;
+
+} // namespace
+
+void RootDevice::descriptionChanged()
+{
+	// Zero is reserved for 'no content'
+	if(++descriptionVersion == 0) {
+		descriptionVersion = 1;
+	}
+	descriptionModified = SystemClock.isSet() ? SystemClock.now(eTZ_UTC) : 0;
+}
+
+String RootDevice::getETag(bool compressed) const
+{
+	if(bootId == 0) {
+		bootId = os_random() | 1;
+	}
+
+	char tag[28];
+	m_snprintf(tag, sizeof(tag), "\"%08x-%u%s\"", unsigned(bootId), unsigned(descriptionVersion),
+			   compressed ? "-gz" : "");
+	return tag;
+}
+
+/*
+ * As per RFC 7232, If-Modified-Since is only considered if If-None-Match is absent.
+ * Tags are compared weakly, which is permitted for GET requests.
+ * Quotes are part of each tag, so the identity tag never matches within the `-gz` one.
+ */
+bool RootDevice::checkNotModified(HttpServerConnection& connection, bool compressed)
+{
+	auto& request = *connection.getRequest();
+	auto& response = *connection.getResponse();
+
+	if(descriptionModified == 0 && SystemClock.isSet()) {
+		descriptionModified = SystemClock.now(eTZ_UTC);
+	}
+
+	String etag = getETag(compressed);
+	bool notModified{false};
+	String ifNoneMatch = request.headers[HTTP_HEADER_IF_NONE_MATCH];
+	if(ifNoneMatch) {
+		notModified = (ifNoneMatch == "*") || ifNoneMatch.indexOf(etag) >= 0;
+	} else if(descriptionModified != 0) {
+		String ifModifiedSince = request.headers[HTTP_HEADER_IF_MODIFIED_SINCE];
+		DateTime dt;
+		if(ifModifiedSince && dt.fromHttpDate(ifModifiedSince)) {
+			notModified = (descriptionModified <= time_t(dt));
+		}
+	}
+
+	response.headers[HTTP_HEADER_ETAG] = etag;
+	if(descriptionModified != 0) {
+		response.headers[HTTP_HEADER_LAST_MODIFIED] = DateTime(descriptionModified).toHTTPDate();
+	}
+
+	if(notModified) {
+		response.headers[HTTP_HEADER_SERVER] = getCachedField(Field::serverId);
+		response.code = HTTP_STATUS_NOT_MODIFIED;
+	}
+
+	return notModified;
+}
+
 Url RootDevice::getURL(const String& path)
 {
 	return Url(URI_SCHEME_HTTP, nullptr, nullptr, WifiStation.getIP().toString(), tcpPort, path);
 }
 
+String RootDevice::getLocation(const String& path, IpAddress localIp)
+{
+	return getBaseURL(localIp) + path;
+}
+
+IpAddress RootDevice::getLocalIp(IpAddress remoteIp)
+{
+	if(WifiAccessPoint.isEnabled()) {
+		auto apIp = WifiAccessPoint.getIP();
+		if(remoteIp.compare(apIp, WifiAccessPoint.getNetworkMask())) {
+			return apIp;
+		}
+	}
+
+	return WifiStation.getIP();
+}
+
+const String& RootDevice::getBaseURL(IpAddress localIp)
+{
+	for(auto& e : baseURLs) {
+		if(e.url && e.localIp == localIp) {
+			return e.url;
+		}
+	}
+
+	auto& entry = baseURLs[nextBaseURL];
+	nextBaseURL = (nextBaseURL + 1) % UPNP_URL_CACHE_SIZE;
+
+	entry.localIp = localIp;
+	entry.url = _F("http://");
+	entry.url += localIp.toString();
+	if(tcpPort != 80) {
+		entry.url += ':';
+		entry.url += tcpPort;
+	}
+	return entry.url;
+}
+
+void RootDevice::clearBaseURLs()
+{
+	for(auto& e : baseURLs) {
+		e.url = nullptr;
+	}
+}
+
 String RootDevice::getField(Field desc)
 {
 	switch(desc) {
 	case Field::presentationURL:
-		return getField(Field::baseURL) + defaultPresentationURL;
+		return getCachedField(Field::baseURL) + defaultPresentationURL;
 	case Field::serverId:
 		return SSDP::SERVER_ID;
 	case Field::baseURL:
@@ -52,7 +169,7 @@ String RootDevice::getField(Field desc)
 bool RootDevice::onHttpRequest(HttpServerConnection& connection)
 {
 	auto request = connection.getRequest();
-	if(request->uri.Path == getField(Field::presentationURL)) {
+	if(matchField(Field::presentationURL, request->uri.Path)) {
 		debug_i("[UPnP] Sending default presentation page for '%s'", getField(Field::type).c_str());
 		auto response = connection.getResponse();
 		auto tmpl = new FSTR::TemplateStream(upnp_default_page);
@@ -72,7 +189,7 @@ bool RootDevice::onHttpRequest(HttpServerConnection& connection)
 	return Device::onHttpRequest(connection);
 }
 
-void RootDevice::search(const SearchFilter& filter)
+void RootDevice::searchSelf(const SearchFilter& filter)
 {
 	if(filter.ms.target() == SearchTarget::root) {
 		filter.callback(this, SearchMatch::root);
@@ -83,7 +200,7 @@ void RootDevice::search(const SearchFilter& filter)
 		filter.callback(this, SearchMatch::root);
 	}
 
-	Device::search(filter);
+	Device::searchSelf(filter);
 }
 
 } // namespace UPnP
@@ -0,0 +1,183 @@
+/**
+ * SearchIndex.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/SearchIndex.h"
+#include "include/Network/UPnP/RootDevice.h"
+#include "include/Network/UPnP/Hash.h"
+#include <algorithm>
+
+namespace UPnP
+{
+bool SearchIndex::add(RootDevice* root)
+{
+	if(root == nullptr) {
+		return false;
+	}
+
+	bool ok = append(root);
+	sort();
+	return ok;
+}
+
+bool SearchIndex::rebuild(RootDevice* first)
+{
+	count_ = 0;
+	bool ok{true};
+	for(auto root = first; root != nullptr; root = root->getNext()) {
+		if(!append(root)) {
+			ok = false;
+		}
+	}
+	sort();
+	return ok;
+}
+
+/*
+ * Add unsorted entries for a tree
+ */
+bool SearchIndex::append(RootDevice* root)
+{
+	// Enumerate everything in the tree using a standard search
+	MessageSpec ms(MessageType::response);
+	ms.setTarget(SearchTarget::all);
+	SearchFilter filter(ms, 0);
+	bool ok{true};
+	filter.callback = [&](Object* object, SearchMatch match) {
+		if(match == SearchMatch::root) {
+			// upnp:rootdevice doesn't require indexing
+			return;
+		}
+		Entry entry;
+		entry.hash = Hash::fnv1a(object->getTargetString(match));
+		entry.object = object;
+		entry.root = root;
+		entry.match = match;
+		if(!append(entry)) {
+			ok = false;
+		}
+	};
+	root->search(filter);
+
+	if(!ok) {
+		debug_e("[UPnP] Search index incomplete, out of memory");
+	}
+
+	return ok;
+}
+
+void SearchIndex::remove(RootDevice* root)
+{
+	unsigned n = 0;
+	for(unsigned i = 0; i < count_; ++i) {
+		if(entries[i].root != root) {
+			entries[n++] = entries[i];
+		}
+	}
+	count_ = n;
+}
+
+unsigned SearchIndex::count(const RootDevice* root) const
+{
+	unsigned n{0};
+	for(unsigned i = 0; i < count_; ++i) {
+		if(entries[i].root == root) {
+			++n;
+		}
+	}
+	return n;
+}
+
+void SearchIndex::clear()
+{
+	free(entries);
+	entries = nullptr;
+	count_ = capacity = 0;
+}
+
+unsigned SearchIndex::lowerBound(uint32_t hash) const
+{
+	unsigned first = 0;
+	unsigned len = count_;
+	while(len != 0) {
+		auto half = len / 2;
+		if(entries[first + half].hash < hash) {
+			first += half + 1;
+			len -= half + 1;
+		} else {
+			len = half;
+		}
+	}
+	return first;
+}
+
+bool SearchIndex::append(const Entry& entry)
+{
+	if(count_ == capacity) {
+		const unsigned increment = 16;
+		if(capacity > UINT16_MAX - increment) {
+			return false;
+		}
+		auto newEntries = static_cast<Entry*>(realloc(entries, (capacity + increment) * sizeof(Entry)));
+		if(newEntries == nullptr) {
+			return false;
+		}
+		entries = newEntries;
+		capacity += increment;
+	}
+
+	entries[count_++] = entry;
+	return true;
+}
+
+void SearchIndex::sort()
+{
+	// Stable, so entries with the same hash stay in tree order
+	std::stable_sort(entries, entries + count_,
+					 [](const Entry& e1, const Entry& e2) { return e1.hash < e2.hash; });
+}
+
+void SearchIndex::search(const SearchFilter& filter) const
+{
+	SearchMatch match;
+	switch(filter.ms.target()) {
+	case SearchTarget::type:
+		match = SearchMatch::type;
+		break;
+	case SearchTarget::uuid:
+		match = SearchMatch::uuid;
+		break;
+	default:
+		assert(false);
+		return;
+	}
+
+	auto hash = filter.targetHash ?: Hash::fnv1a(filter.targetString);
+	for(unsigned i = lowerBound(hash); i < count_ && entries[i].hash == hash; ++i) {
+		auto& entry = entries[i];
+		if(entry.match != match) {
+			continue;
+		}
+		// Confirm to guard against hash collisions
+		if(entry.object->matchTarget(match, filter.targetString)) {
+			filter.callback(entry.object, match);
+		}
+	}
+}
+
+} // namespace UPnP
@@ -18,6 +18,9 @@
  ****/
 
 #include "include/Network/UPnP/RootDevice.h"
+#include "include/Network/UPnP/DeviceHost.h"
+#include "include/Network/UPnP/XmlWriter.h"
+#include "include/Network/UPnP/Hash.h"
 #include "include/Network/UPnP/ItemEnumerator.h"
 #include "include/Network/UPnP/DescriptionStream.h"
 #include <Data/Stream/MemoryDataStream.h>
@@ -36,6 +39,11 @@ UPNP_SERVICE_FIELD_MAP(XX);
 DEFINE_FSTR_VECTOR(fieldNames, FlashString, UPNP_SERVICE_FIELD_MAP(XX))
 #undef XX
 
+DEFINE_FSTR_LOCAL(tag_scpd, "scpd")
+DEFINE_FSTR_LOCAL(tag_service, "service")
+DEFINE_FSTR_LOCAL(attr_xmlns, "xmlns")
+DEFINE_FSTR_LOCAL(service_xmlns, "urn:schemas-upnp-org:service-1-0")
+
 } // namespace
 
 String toString(UPnP::Service::Field field)
@@ -43,6 +51,29 @@ String toString(UPnP::Service::Field field)
 	return fieldNames[unsigned(field)];
 }
 
+/*
+ * As for Device fields, names are hashed at compile time so a collision would fail to build.
+ */
+bool fromString(const char* name, UPnP::Service::Field& field)
+{
+	if(name == nullptr) {
+		return false;
+	}
+
+	switch(UPnP::Hash::fnv1a(name, strlen(name))) {
+#define XX(tag, req)                                                                                                   \
+	case UPnP::Hash::fnv1a(#tag):                                                                                      \
+		field = UPnP::Service::Field::tag;                                                                             \
+		break;
+		UPNP_SERVICE_FIELD_MAP(XX)
+#undef XX
+	default:
+		return false;
+	}
+
+	return fieldNames[unsigned(field)].equals(name);
+}
+
 namespace UPnP
 {
 RootDevice* Service::getRoot()
@@ -50,25 +81,31 @@ RootDevice* Service::getRoot()
 	return (device_ == nullptr) ? nullptr : device_->getRoot();
 }
 
-XML::Node* Service::getDescription(XML::Document& doc, DescType descType)
+const FlashString* Service::writeDescription(XmlWriter& writer, DescType descType)
 {
 	switch(descType) {
-	case DescType::header: {
-		auto root = XML::appendNode(&doc, "scpd");
-		XML::appendAttribute(root, _F("xmlns"), _F("urn:schemas-upnp-org:service-1-0"));
-		return root;
-	}
+	case DescType::header:
+		writer.openTag(tag_scpd);
+		writer.attribute(attr_xmlns, service_xmlns);
+		return &tag_scpd;
 
 	case DescType::embedded: {
-		String s;
-		auto service = XML::appendNode(&doc, _F("service"));
+		writer.openTag(tag_service);
+		auto descriptor = getDescriptor();
 		for(unsigned i = 0; i < unsigned(Field::customStart); ++i) {
-			s = getField(Field(i));
-			if(s) {
-				XML::appendNode(service, fieldNames[i], s);
+			// Skip absent fields, and read constant ones directly
+			if(descriptor != nullptr && !descriptor->isPresent(Field(i))) {
+				continue;
+			}
+			auto value = Descriptor::get(descriptor, Field(i));
+			if(value != nullptr) {
+				writer.field(fieldNames[i], [value](Print& p) { return p.print(*value); });
+			} else {
+				// Null values are omitted, empty ones written as empty elements
+				writer.field(fieldNames[i], getCachedField(Field(i)));
 			}
 		}
-		return service;
+		return &tag_service;
 	}
 
 	case DescType::content: {
@@ -83,10 +120,15 @@ XML::Node* Service::getDescription(XML::Document& doc, DescType descType)
 
 String Service::getField(Field desc)
 {
+	auto value = Descriptor::get(getDescriptor(), desc);
+	if(value != nullptr) {
+		return *value;
+	}
+
 	// Provide defaults for required fields
 	switch(desc) {
 	case Field::serviceType:
-		return ServiceUrn(getField(Field::domain), getField(Field::type), getField(Field::version));
+		return ServiceUrn(getCachedField(Field::domain), getCachedField(Field::type), getCachedField(Field::version));
 
 	case Field::type:
 		return F("{type REQUIRED}");
@@ -98,20 +140,20 @@ String Service::getField(Field desc)
 		return String('1');
 
 	case Field::SCPDURL:
-		return getField(Field::baseURL) + _F("desc.xml");
+		return getCachedField(Field::baseURL) + _F("desc.xml");
 
 	case Field::controlURL:
-		return getField(Field::baseURL) + _F("control");
+		return getCachedField(Field::baseURL) + _F("control");
 
 	case Field::eventSubURL:
-		return getField(Field::baseURL) + _F("event");
+		return getCachedField(Field::baseURL) + _F("event");
 
 	case Field::domain:
-		return device_->getField(Device::Field::domain);
+		return device_->getCachedField(Device::Field::domain);
 
 	case Field::baseURL: {
-		String url = device_->getField(Device::Field::baseURL);
-		String s = getField(Field::type);
+		String url = device_->getCachedField(Device::Field::baseURL);
+		String s = getCachedField(Field::type);
 		splitTypeVersion(s);
 		url += s;
 		url += '/';
@@ -145,7 +187,7 @@ void Service::search(const SearchFilter& filter)
 		filter.callback(this, SearchMatch::type);
 		break;
 	case SearchTarget::type:
-		if(filter.targetString == getField(Field::serviceType)) {
+		if(matchField(Field::serviceType, filter.targetString)) {
 			filter.callback(this, SearchMatch::type);
 		}
 		break;
@@ -154,27 +196,92 @@ void Service::search(const SearchFilter& filter)
 	}
 }
 
+String Service::getCachedField(Field desc)
+{
+	auto constValue = Descriptor::get(getDescriptor(), desc);
+	if(constValue != nullptr) {
+		return *constValue;
+	}
+
+	if(!fieldCache) {
+		return getField(desc);
+	}
+
+	String value;
+	if(!fieldCache->get(unsigned(desc), value)) {
+		value = getField(desc);
+		fieldCache->set(unsigned(desc), value);
+	}
+	return value;
+}
+
+size_t Service::printField(Print& p, Field desc)
+{
+	auto value = Descriptor::get(getDescriptor(), desc);
+	if(value != nullptr) {
+		return p.print(*value);
+	}
+
+	size_t count;
+	if(fieldCache && fieldCache->print(unsigned(desc), p, count)) {
+		return count;
+	}
+
+	return p.print(getCachedField(desc));
+}
+
+bool Service::matchField(Field desc, const String& value)
+{
+	auto constValue = Descriptor::get(getDescriptor(), desc);
+	if(constValue != nullptr) {
+		return *constValue == value;
+	}
+
+	return value == getCachedField(desc);
+}
+
+String Service::getTargetString(SearchMatch match)
+{
+	return (match == SearchMatch::type) ? getCachedField(Field::serviceType) : nullptr;
+}
+
+bool Service::matchTarget(SearchMatch match, const String& target)
+{
+	return (match == SearchMatch::type) && matchField(Field::serviceType, target);
+}
+
 bool Service::formatMessage(Message& msg, MessageSpec& ms)
 {
-	if(ms.match() != SearchMatch::type) {
-		debug_e("[UPnP] Invalid search match value");
+	auto root = getRoot();
+	if(root == nullptr) {
+		// Detached from its device, or the device from its tree
 		return false;
 	}
 
-	msg[HTTP_HEADER_SERVER] = device_->getField(Device::Field::serverId);
-	msg[HTTP_HEADER_LOCATION] = getRoot()->getURL(getField(Field::SCPDURL)).toString();
+	auto& cache = headerCache ? *headerCache : deviceHost.getHeaderCache();
+	auto localIp = RootDevice::getLocalIp(ms.remoteIp());
+	auto headers = cache.find(this, ms.match(), localIp);
+	if(headers == nullptr) {
+		String st = getTargetString(ms.match());
+		if(!st) {
+			debug_e("[UPnP] Invalid search match value");
+			return false;
+		}
 
-	String st = getField(Field::serviceType);
-	String usn = device_->getField(Device::Field::UDN);
-	usn += "::";
-	usn += st;
+		String usn = device_->getCachedField(Device::Field::UDN);
+		usn += "::";
+		usn += st;
 
-	if(msg.type == MessageType::notify) {
-		msg["NT"] = st;
-	} else {
-		msg["ST"] = st;
+		String location = root->getLocation(getCachedField(Field::SCPDURL), localIp);
+		String serverId = device_->getCachedField(Device::Field::serverId);
+		headers = cache.add(this, ms.match(), localIp, serverId, location, st, usn);
+		if(headers == nullptr) {
+			HeaderCache::apply(msg, serverId.c_str(), location.c_str(), st.c_str(), usn.c_str());
+			return true;
+		}
 	}
-	msg["USN"] = usn;
+
+	headers->apply(msg);
 	return true;
 }
 
@@ -242,24 +349,24 @@ bool Service::onHttpRequest(HttpServerConnection& connection)
 		UUID uuid;
 		uuid.generate();
 
-		response.headers[HTTP_HEADER_SERVER] = device_->getField(Device::Field::serverId);
+		response.headers[HTTP_HEADER_SERVER] = device_->getCachedField(Device::Field::serverId);
 		response.headers["SID"] = String("uuid:") + String(uuid);
 		response.headers[HTTP_HEADER_CONTENT_LENGTH] = "0";
 		response.headers["TIMEOUT"] = "1800";
 		response.code = HTTP_STATUS_OK;
 	};
 
-	if(uri.Path == getField(Field::SCPDURL)) {
+	if(matchField(Field::SCPDURL, uri.Path)) {
 		printRequest();
-		if(request.method == HTTP_GET) {
-			device_->sendXml(response, createDescription());
-		} else {
+		if(request.method != HTTP_GET) {
 			response.code = HTTP_STATUS_BAD_REQUEST;
+		} else {
+			device_->sendDescription(connection, *this);
 		}
 		return true;
 	}
 
-	if(uri.Path == getField(Field::controlURL)) {
+	if(matchField(Field::controlURL, uri.Path)) {
 		printRequest();
 		if(request.method == HTTP_POST) {
 			handleControl();
@@ -269,7 +376,7 @@ bool Service::onHttpRequest(HttpServerConnection& connection)
 		return true;
 	}
 
-	if(uri.Path == getField(Field::eventSubURL)) {
+	if(matchField(Field::eventSubURL, uri.Path)) {
 		printRequest(true);
 		// TODO: Handle this URL
 		if(request.method == HTTP_SUBSCRIBE || request.method == HTTP_UNSUBSCRIBE) {
@@ -0,0 +1,176 @@
+/**
+ * TreeWalker.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/TreeWalker.h"
+#include "include/Network/UPnP/RootDevice.h"
+
+namespace UPnP
+{
+void TreeWalker::begin(Device* device, bool siblings, bool descend)
+{
+	clear();
+	first = device;
+	this->siblings = siblings;
+	this->descend = descend;
+	startTree(device);
+}
+
+void TreeWalker::startTree(Device* device)
+{
+	treeRoot = nullptr;
+	if(device != nullptr && push(device)) {
+		treeRoot = device->getRoot();
+	}
+}
+
+bool TreeWalker::push(Device* device)
+{
+	if(depth == UPNP_TREE_DEPTH) {
+		debug_w("[UPnP] Device %p: tree too deep, skipping", device);
+		return false;
+	}
+
+	stack[depth++] = Frame{device, device->services_.head(), nullptr, nullptr, State::self};
+	return true;
+}
+
+void TreeWalker::pop()
+{
+	auto& frame = stack[--depth];
+	delete frame.services;
+	delete frame.devices;
+	if(depth == 0) {
+		startTree(siblings ? frame.device->getNext() : nullptr);
+	}
+}
+
+void TreeWalker::clear()
+{
+	while(depth != 0) {
+		auto& frame = stack[--depth];
+		delete frame.services;
+		delete frame.devices;
+	}
+	treeRoot = nullptr;
+}
+
+void TreeWalker::skipTree()
+{
+	if(depth == 0) {
+		return;
+	}
+	while(depth > 1) {
+		pop();
+	}
+	pop();
+}
+
+void TreeWalker::removed(Device* device)
+{
+	if(device == first) {
+		first = siblings ? device->getNext() : nullptr;
+	}
+	if(depth != 0 && stack[0].device == device) {
+		skipTree();
+	}
+}
+
+bool TreeWalker::step(const SearchFilter& filter)
+{
+	while(depth != 0) {
+		auto& frame = stack[depth - 1];
+		auto device = frame.device;
+		switch(frame.state) {
+		case State::self:
+			frame.state = State::services;
+			device->searchSelf(filter);
+			if(!descend || filter.ms.target() == SearchTarget::root) {
+				pop();
+			}
+			return true;
+
+		case State::services:
+			// Devices are identified by UDN, services aren't
+			if(frame.item != nullptr && filter.ms.target() != SearchTarget::uuid) {
+				auto service = static_cast<Service*>(frame.item);
+				frame.item = service->getNext();
+				service->search(filter);
+				return true;
+			}
+			frame.state = State::serviceCollection;
+			if(filter.ms.target() != SearchTarget::uuid) {
+				auto collection = device->getServiceCollection();
+				if(collection != nullptr && collection->isPersistent()) {
+					frame.services = collection->clone();
+					frame.services->reset();
+				}
+			}
+			continue;
+
+		case State::serviceCollection:
+			if(frame.services != nullptr) {
+				auto service = frame.services->current();
+				if(service != nullptr) {
+					frame.services->next();
+					service->search(filter);
+					return true;
+				}
+				delete frame.services;
+				frame.services = nullptr;
+			}
+			frame.state = State::devices;
+			frame.item = device->devices_.head();
+			continue;
+
+		case State::devices:
+			if(frame.item != nullptr) {
+				auto child = static_cast<Device*>(frame.item);
+				frame.item = child->getNext();
+				push(child);
+				continue;
+			}
+			frame.state = State::deviceCollection;
+			{
+				// Re-used instances cannot be referenced by pending messages, so are not discoverable
+				auto collection = device->getDeviceCollection();
+				if(collection != nullptr && collection->isPersistent()) {
+					frame.devices = collection->clone();
+					frame.devices->reset();
+				}
+			}
+			continue;
+
+		case State::deviceCollection:
+			if(frame.devices != nullptr) {
+				auto child = frame.devices->current();
+				if(child != nullptr) {
+					frame.devices->next();
+					push(child);
+					continue;
+				}
+			}
+			pop();
+			continue;
+		}
+	}
+
+	return false;
+}
+
+} // namespace UPnP
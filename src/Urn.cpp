@@ -18,6 +18,9 @@
  ****/
 
 #include "include/Network/UPnP/Urn.h"
+#include "include/Network/UPnP/Hash.h"
+#include <stringconversion.h>
+#include <ctype.h>
 
 namespace UPnP
 {
@@ -37,6 +40,102 @@ String Urn::toString() const
 	return s;
 }
 
+uint32_t Urn::hash() const
+{
+	char versionString[4];
+	ultoa(version, versionString, 10);
+
+	uint32_t h = Hash::fnv1a("urn:", 4);
+	h = Hash::fnv1a(domain, h);
+	h = Hash::fnv1a(':', h);
+	auto kindString = (kind == Kind::service) ? "service" : "device";
+	h = Hash::fnv1a(kindString, strlen(kindString), h);
+	h = Hash::fnv1a(':', h);
+	h = Hash::fnv1a(type, h);
+	h = Hash::fnv1a(':', h);
+	return Hash::fnv1a(versionString, strlen(versionString), h);
+}
+
+bool Urn::operator==(const UrnRef& ref) const
+{
+	return kind == ref.kind && version == ref.version && domain.length() == ref.domainLength &&
+		   type.length() == ref.typeLength && memcmp(domain.c_str(), ref.domain, ref.domainLength) == 0 &&
+		   memcmp(type.c_str(), ref.type, ref.typeLength) == 0;
+}
+
+bool UrnRef::parse(const char* value, size_t length)
+{
+	kind = Urn::Kind::none;
+
+	// urn:{domain}:{kind}:{type}:{version}
+	if(value == nullptr || length < 4 || memcmp(value, "urn:", 4) != 0) {
+		return false;
+	}
+
+	const char* tokens[4];
+	size_t lengths[4];
+	auto p = value + 4;
+	auto end = value + length;
+	for(unsigned i = 0; i < 4; ++i) {
+		auto sep = (i < 3) ? static_cast<const char*>(memchr(p, ':', end - p)) : end;
+		if(sep == nullptr || sep == p) {
+			return false;
+		}
+		tokens[i] = p;
+		lengths[i] = sep - p;
+		p = sep + 1;
+	}
+
+	Urn::Kind k;
+	if(lengths[1] == 6 && memcmp(tokens[1], "device", 6) == 0) {
+		k = Urn::Kind::device;
+	} else if(lengths[1] == 7 && memcmp(tokens[1], "service", 7) == 0) {
+		k = Urn::Kind::service;
+	} else {
+		return false;
+	}
+
+	if(lengths[0] > 255 || lengths[2] > 255 || lengths[3] > 3) {
+		return false;
+	}
+
+	unsigned ver{0};
+	for(unsigned i = 0; i < lengths[3]; ++i) {
+		char c = tokens[3][i];
+		if(!isdigit(c)) {
+			return false;
+		}
+		ver = (ver * 10) + (c - '0');
+	}
+	if(ver == 0 || ver > 255) {
+		return false;
+	}
+
+	domain = tokens[0];
+	domainLength = lengths[0];
+	type = tokens[2];
+	typeLength = lengths[2];
+	version = ver;
+	hash = Hash::fnv1a(value, length);
+	kind = k;
+	return true;
+}
+
+bool UrnRef::operator==(const UrnRef& other) const
+{
+	return hash == other.hash && kind == other.kind && version == other.version &&
+		   domainLength == other.domainLength && typeLength == other.typeLength &&
+		   memcmp(domain, other.domain, domainLength) == 0 && memcmp(type, other.type, typeLength) == 0;
+}
+
+Urn UrnRef::toUrn() const
+{
+	if(kind == Urn::Kind::none) {
+		return Urn();
+	}
+	return Urn(kind, String(domain, domainLength), String(type, typeLength), version);
+}
+
 } // namespace UPnP
 
 String toString(UPnP::Urn::Kind kind)
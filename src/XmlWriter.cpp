@@ -0,0 +1,220 @@
+/**
+ * XmlWriter.cpp
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/UPnP/XmlWriter.h"
+
+namespace
+{
+/**
+ * @brief Appends text to a String
+ */
+class StringPrint : public Print
+{
+public:
+	StringPrint(String& out) : out(out)
+	{
+	}
+
+	size_t write(uint8_t c) override
+	{
+		out += char(c);
+		return 1;
+	}
+
+	size_t write(const uint8_t* buffer, size_t size) override
+	{
+		return out.concat(reinterpret_cast<const char*>(buffer), size) ? size : 0;
+	}
+
+protected:
+	String& out;
+};
+
+/**
+ * @brief Appends text to a String, replacing reserved characters with entity references
+ * @note Returns the number of source characters written, not the expanded length
+ */
+class EscapePrint : public StringPrint
+{
+public:
+	using StringPrint::StringPrint;
+
+	size_t write(uint8_t c) override
+	{
+		switch(c) {
+		case '<':
+			out += _F("&lt;");
+			break;
+		case '>':
+			out += _F("&gt;");
+			break;
+		case '\'':
+			out += _F("&apos;");
+			break;
+		case '"':
+			out += _F("&quot;");
+			break;
+		case '&':
+			out += _F("&amp;");
+			break;
+		default:
+			out += char(c);
+		}
+		return 1;
+	}
+
+	size_t write(const uint8_t* buffer, size_t size) override
+	{
+		for(size_t i = 0; i < size; ++i) {
+			write(buffer[i]);
+		}
+		return size;
+	}
+};
+
+} // namespace
+
+namespace UPnP
+{
+void XmlWriter::declaration()
+{
+	endStartTag();
+	indent();
+	out += _F("<?xml version=\"1.0\" encoding=\"utf-8\"?>");
+	newline();
+}
+
+void XmlWriter::openTag(const FlashString& name)
+{
+	endStartTag();
+	indent();
+	out += '<';
+	StringPrint p(out);
+	name.printTo(p);
+	tagOpen = true;
+	++depth;
+}
+
+void XmlWriter::attribute(const FlashString& name, const FlashString& value)
+{
+	out += ' ';
+	StringPrint p(out);
+	name.printTo(p);
+	out += "=\"";
+	EscapePrint e(out);
+	value.printTo(e);
+	out += '"';
+}
+
+void XmlWriter::endStartTag()
+{
+	if(!tagOpen) {
+		return;
+	}
+
+	out += '>';
+	tagOpen = false;
+	newline();
+}
+
+void XmlWriter::closeTag(const FlashString& name)
+{
+	if(depth > 0) {
+		--depth;
+	}
+
+	if(tagOpen) {
+		// No content
+		out += "/>";
+		tagOpen = false;
+	} else {
+		indent();
+		out += "</";
+		StringPrint p(out);
+		name.printTo(p);
+		out += '>';
+	}
+	newline();
+}
+
+void XmlWriter::field(const FlashString& name, PrintFieldCallback print)
+{
+	endStartTag();
+
+	indent();
+	out += '<';
+	StringPrint p(out);
+	name.printTo(p);
+	auto mark = out.length();
+	out += '>';
+
+	EscapePrint e(out);
+	if(print(e) == 0) {
+		// Empty element, as XML::serialize() writes it
+		out.setLength(mark);
+		out += "/>";
+	} else {
+		out += "</";
+		name.printTo(p);
+		out += '>';
+	}
+	newline();
+}
+
+bool XmlWriter::field(const FlashString& name, const String& value)
+{
+	if(!value) {
+		return false;
+	}
+
+	field(name, [&value](Print& p) { return p.print(value); });
+	return true;
+}
+
+void XmlWriter::field(const FlashString& name, unsigned value)
+{
+	field(name, [value](Print& p) { return p.print(value); });
+}
+
+String XmlWriter::escape(const String& value)
+{
+	String s;
+	s.reserve(value.length());
+	EscapePrint e(s);
+	e.print(value);
+	return s;
+}
+
+void XmlWriter::indent()
+{
+	if(pretty) {
+		for(unsigned i = 0; i < depth; ++i) {
+			out += '\t';
+		}
+	}
+}
+
+void XmlWriter::newline()
+{
+	if(pretty) {
+		out += '\n';
+	}
+}
+
+} // namespace UPnP
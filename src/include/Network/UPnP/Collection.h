@@ -0,0 +1,134 @@
+/**
+ * Collection.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "ItemEnumerator.h"
+
+namespace UPnP
+{
+class Device;
+class Service;
+
+/**
+ * @brief Shared-instance collection of devices or services
+ *
+ * A device may return one of these in addition to any devices or services added to it,
+ * so that large numbers of similar objects can be presented without creating an instance for each.
+ * Typically the same instance is returned for every item, with its state updated to reflect
+ * the current position.
+ *
+ * @note Unless `isPersistent()` returns true, items are description-only:
+ * they appear in the owning device's description and receive HTTP requests,
+ * but are never announced, included in the search index or returned in M-SEARCH responses.
+ * Control points must discover them by reading the parent device description.
+ *
+ * After `reset()`, `current()` returns the first item.
+ * `clone()` must return an enumerator with its own item instance so that it may be used
+ * independently, e.g. whilst a description is being streamed.
+ *
+ * Items must be linked to the owning device by calling `Device::attach()`.
+ */
+template <typename ItemType, class EnumeratorType> class Collection : public Enumerator<ItemType, EnumeratorType>
+{
+public:
+	/**
+	 * @brief Determine whether items remain valid after the enumerator has moved on
+	 * @retval bool false if the same instance is re-used for every item
+	 *
+	 * Pending SSDP messages and the search index refer to objects directly,
+	 * so only persistent items can be announced or found via M-SEARCH.
+	 * Return true only if every item has its own instance which lives as long as the collection.
+	 * All items are included in descriptions and receive HTTP requests regardless.
+	 */
+	virtual bool isPersistent() const
+	{
+		return false;
+	}
+};
+
+class DeviceCollection : public Collection<Device, DeviceCollection>
+{
+};
+
+class ServiceCollection : public Collection<Service, ServiceCollection>
+{
+};
+
+/**
+ * @brief Enumerates a linked list followed by the items in a collection
+ * @note Used by DescriptionStream. Takes ownership of the collection.
+ */
+template <class CollectionType> class CollectionItemEnumerator : public ItemEnumerator
+{
+public:
+	CollectionItemEnumerator(Item* head, CollectionType* collection)
+		: ItemEnumerator(head), collection(collection), inCollection(head == nullptr)
+	{
+		collection->reset();
+	}
+
+	CollectionItemEnumerator(const CollectionItemEnumerator& other)
+		: ItemEnumerator(other), collection(other.collection->clone()), inCollection(other.inCollection)
+	{
+	}
+
+	~CollectionItemEnumerator()
+	{
+		delete collection;
+	}
+
+	ItemEnumerator* clone() override
+	{
+		return new CollectionItemEnumerator(*this);
+	}
+
+	void reset() override
+	{
+		ItemEnumerator::reset();
+		collection->reset();
+		inCollection = (ItemEnumerator::current() == nullptr);
+	}
+
+	Item* current() override
+	{
+		return inCollection ? collection->current() : ItemEnumerator::current();
+	}
+
+	Item* next() override
+	{
+		if(inCollection) {
+			return collection->next();
+		}
+
+		auto item = ItemEnumerator::next();
+		if(item != nullptr) {
+			return item;
+		}
+
+		inCollection = true;
+		return collection->current();
+	}
+
+private:
+	CollectionType* collection;
+	bool inCollection;
+};
+
+} // namespace UPnP
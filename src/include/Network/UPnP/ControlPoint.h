@@ -99,6 +99,7 @@ private:
 	static HttpClient http;
 	size_t maxDescriptionSize; // <<< Maximum size of XML description that can be processed
 	UPnP::Urn searchUrn;
+	uint32_t searchHash{0};
 	DescriptionCallback searchCallback;
 	CStringArray uniqueServiceNames;
 };
@@ -0,0 +1,93 @@
+/**
+ * DescriptionCache.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <Data/Stream/DataSourceStream.h>
+#include <memory>
+
+/**
+ * @brief Store rendered descriptions in files instead of RAM
+ */
+#ifndef UPNP_DESCRIPTION_CACHE_FILES
+#define UPNP_DESCRIPTION_CACHE_FILES 0
+#endif
+
+namespace UPnP
+{
+class DescriptionCacheFile;
+
+/**
+ * @brief Holds a rendered description so that repeated requests don't walk the object tree
+ *
+ * Content is tagged with a version number, normally that of the root device,
+ * and is only valid whilst that remains unchanged.
+ * Content is kept in RAM unless UPNP_DESCRIPTION_CACHE_FILES is set, in which case
+ * it is written to the filesystem. Either way, content which has been replaced is kept
+ * until no stream refers to it.
+ *
+ * Files are named `upnp_<owner>_<sequence>.xml`. Any left over from a previous boot
+ * are deleted when the first file is written.
+ */
+class DescriptionCache
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param owner Used to give files a unique name
+	 */
+	DescriptionCache(const void* owner) : owner(owner)
+	{
+	}
+
+	~DescriptionCache()
+	{
+		clear();
+	}
+
+	/**
+	 * @brief Get a stream for the cached content
+	 * @param version Current description version
+	 * @retval IDataSourceStream* nullptr if there is no content for this version
+	 */
+	IDataSourceStream* getStream(uint32_t version);
+
+	/**
+	 * @brief Render a description into the cache, replacing existing content
+	 * @param source The description, read to completion
+	 * @param version Description version for the content
+	 * @retval bool false if the content could not be stored
+	 * @note Streams already obtained via `getStream()` remain valid, and continue to
+	 * read the previous content
+	 */
+	bool update(IDataSourceStream& source, uint32_t version);
+
+	void clear();
+
+private:
+#if UPNP_DESCRIPTION_CACHE_FILES
+	std::shared_ptr<DescriptionCacheFile> file;
+#else
+	std::shared_ptr<const String> content;
+#endif
+	const void* owner;
+	uint32_t version{0}; ///< 0 if there is no content
+};
+
+} // namespace UPnP
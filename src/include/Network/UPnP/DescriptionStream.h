@@ -63,13 +63,15 @@ public:
 protected:
 	void freeMem();
 	void getContent();
+	void writeFooter();
 
 private:
 	Object* object_{nullptr};
 	// Nesting levels
 	struct Segment {
 		Item* item{nullptr};
-		String footer;
+		const FlashString* headerTag{nullptr}; ///< Document element, closed after item
+		const FlashString* tag{nullptr};	   ///< Item element
 		ItemEnumerator* list{nullptr}; // active list
 		String listName;
 		uint8_t listIndex{0};
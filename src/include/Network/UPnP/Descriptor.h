@@ -0,0 +1,101 @@
+/**
+ * Descriptor.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <FlashString/String.hpp>
+
+namespace UPnP
+{
+/**
+ * @brief Compile-time description of a device or service
+ * @tparam Field The object's field enumeration, `Device::Field` or `Service::Field`
+ *
+ * Lists which fields have values, and provides those which are constant from flash memory.
+ * Fields not marked as present are omitted from descriptions without calling `getField()`.
+ * Constant fields are read directly, without virtual calls.
+ * Dynamic fields are marked present, and their values obtained from `getField()` as usual.
+ *
+ * Define as a `constexpr` object in flash, for example:
+ *
+ * ```
+ * DEFINE_FSTR_LOCAL(fs_name, "Sming Tea Pot")
+ * DEFINE_FSTR_LOCAL(fs_udn, "uuid:1231313131::upnp:tea-pot")
+ *
+ * constexpr Device::Descriptor teapotDescriptor PROGMEM =
+ *     Device::Descriptor()
+ *         .value(Device::Field::friendlyName, fs_name)
+ *         .value(Device::Field::UDN, fs_udn)
+ *         .dynamic(Device::Field::presentationURL);
+ * ```
+ *
+ * Then return it from the object's `getDescriptor()` method.
+ */
+template <typename Field> struct ObjectDescriptor {
+	static constexpr unsigned fieldCount{unsigned(Field::MAX)};
+	static_assert(fieldCount <= 32, "Too many fields for descriptor");
+
+	const FlashString* values[fieldCount]{}; ///< Constant values, nullptr for dynamic or absent fields
+	uint32_t present{0};					 ///< Bitmask of fields which have a value
+
+	/**
+	 * @brief Set a constant field value
+	 */
+	constexpr ObjectDescriptor& value(Field field, const FlashString& value)
+	{
+		values[unsigned(field)] = &value;
+		present |= 1U << unsigned(field);
+		return *this;
+	}
+
+	/**
+	 * @brief Mark a field as present, with value provided by `getField()`
+	 */
+	constexpr ObjectDescriptor& dynamic(Field field)
+	{
+		present |= 1U << unsigned(field);
+		return *this;
+	}
+
+	/**
+	 * @brief Get a constant value
+	 * @retval FlashString* nullptr if field is not constant
+	 */
+	const FlashString* getValue(Field field) const
+	{
+		return (unsigned(field) < fieldCount) ? values[unsigned(field)] : nullptr;
+	}
+
+	/**
+	 * @brief Get a constant value from an object's descriptor
+	 * @param descriptor As returned from `getDescriptor()`, may be nullptr
+	 * @retval FlashString* nullptr if there is no descriptor or the field is not constant
+	 */
+	static const FlashString* get(const ObjectDescriptor* descriptor, Field field)
+	{
+		return (descriptor == nullptr) ? nullptr : descriptor->getValue(field);
+	}
+
+	bool isPresent(Field field) const
+	{
+		return (present & (1U << unsigned(field))) != 0;
+	}
+};
+
+} // namespace UPnP
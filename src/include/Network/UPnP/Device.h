@@ -20,6 +20,8 @@
 #pragma once
 
 #include "Service.h"
+#include "Descriptor.h"
+#include "Collection.h"
 
 #define UPNP_DEVICE_FIELD_MAP(XX)                                                                                      \
 	XX(deviceType, required)                                                                                           \
@@ -60,42 +62,209 @@ public:
 		MAX
 	};
 
-	RootDevice* getRoot() override;
+	using Descriptor = ObjectDescriptor<Field>;
+
+	/**
+	 * @brief Get the root device for this tree
+	 * @retval RootDevice* nullptr if device is not attached to a root device
+	 * @note The root is cached and updated whenever the device is attached or detached
+	 */
+	RootDevice* getRoot() override
+	{
+		return root_;
+	}
 
 	bool isRoot() const
 	{
 		return parent_ == nullptr;
 	}
 
+	Device* getParent() const
+	{
+		return parent_;
+	}
+
 	void search(const SearchFilter& filter) override;
+
+	/**
+	 * @brief Report matches for this device alone, excluding embedded devices and services
+	 * @note Called by `search()`, and when a search is spread over several task callbacks
+	 */
+	virtual void searchSelf(const SearchFilter& filter);
+
+	String getTargetString(SearchMatch match) override;
+	bool matchTarget(SearchMatch match, const String& target) override;
 	bool formatMessage(Message& msg, MessageSpec& ms) override;
 
 	virtual String getField(Field desc);
 
+	/**
+	 * @brief Get the static descriptor for this device, if it has one
+	 * @retval Descriptor* nullptr if fields are all obtained from `getField()`
+	 */
+	virtual const Descriptor* getDescriptor()
+	{
+		return nullptr;
+	}
+
+	/**
+	 * @brief Get a field value, using the memoized value if field caching is enabled
+	 * @see `Object::enableFieldCache()`
+	 */
+	String getCachedField(Field desc);
+
+	/**
+	 * @brief Write a field value
+	 * @param p Output
+	 * @param desc
+	 * @retval size_t Number of characters written
+	 *
+	 * Used to build descriptions without creating temporary String objects.
+	 * The default implementation prints the memoized value if field caching is enabled,
+	 * otherwise the value from `getField()`.
+	 * Override this together with `getField()` to print flash strings directly.
+	 */
+	virtual size_t printField(Print& p, Field desc);
+
+	/**
+	 * @brief Compare a field value, using the descriptor if available
+	 */
+	bool matchField(Field desc, const String& value);
+
+	/**
+	 * @brief Enable field caching for this device, embedded devices and services
+	 * @note Devices and services added subsequently inherit the setting
+	 */
+	void enableFieldCache(bool enable) override;
+
+	/**
+	 * @brief Enable description caching for this device, embedded devices and services
+	 * @note Devices and services added subsequently inherit the setting
+	 */
+	void enableDescriptionCache(bool enable) override;
+
+	/**
+	 * @brief Invalidate fields for this device, embedded devices and services
+	 *
+	 * Embedded devices and services build URLs from those of their parent so must also be invalidated.
+	 */
+	void invalidateFields() override;
+
 	bool onHttpRequest(HttpServerConnection& connection) override;
 
-	void addDevice(Device* device)
+	/**
+	 * @brief Add an embedded device
+	 * @note If this device is registered then the host is informed of the change
+	 */
+	void addDevice(Device* device);
+
+	/**
+	 * @brief Add a service
+	 * @note If this device is registered then the host is informed of the change
+	 */
+	void addService(Service* service);
+
+	/**
+	 * @brief Detach an embedded device
+	 * @param device The device, together with any devices and services it contains
+	 * @retval bool false if device is not embedded in this one
+	 * @note If this device is registered then the host is informed of the change.
+	 * The application remains responsible for the detached device, and may destroy it
+	 * once this call returns: any messages for it not yet sent are discarded.
+	 */
+	bool removeDevice(Device* device);
+
+	/**
+	 * @brief Detach a service
+	 * @param service
+	 * @retval bool false if service does not belong to this device
+	 * @note If this device is registered then the host is informed of the change.
+	 * The service may be destroyed once this call returns: any messages for it not yet sent are discarded.
+	 */
+	bool removeService(Service* service);
+
+	/**
+	 * @brief Get a shared-instance collection of embedded devices
+	 * @retval DeviceCollection* nullptr if there are none
+	 *
+	 * Items are enumerated after any devices added via `addDevice()`.
+	 * They are not announced or returned in M-SEARCH responses
+	 * unless :cpp:func:`UPnP::Collection::isPersistent` returns true.
+	 * The collection remains owned by this device.
+	 * Call :cpp:func:`UPnP::DeviceHost::deviceChanged` if the collection contents change.
+	 */
+	virtual DeviceCollection* getDeviceCollection()
+	{
+		return nullptr;
+	}
+
+	/**
+	 * @brief Get a shared-instance collection of services
+	 * @retval ServiceCollection* nullptr if there are none
+	 * @note As for devices, non-persistent items are not discoverable via SSDP
+	 * @see `getDeviceCollection()`
+	 */
+	virtual ServiceCollection* getServiceCollection()
+	{
+		return nullptr;
+	}
+
+	/**
+	 * @brief Link a device instance belonging to a collection
+	 * @param device
+	 *
+	 * The device is given this one as its parent, but is not added to the device list.
+	 * Field caching is not enabled as values change with enumerator position.
+	 */
+	void attach(Device* device)
 	{
-		devices_.add(device);
 		device->parent_ = this;
+		device->setRoot(getRoot());
 	}
 
-	void addService(Service* service)
+	/**
+	 * @brief Link a service instance belonging to a collection
+	 * @param service
+	 */
+	void attach(Service* service)
 	{
-		services_.add(service);
 		service->setDevice(this);
 	}
 
-	XML::Node* getDescription(XML::Document& doc, DescType descType) override;
+	/**
+	 * @brief Check consistency of this device and everything it contains
+	 * @retval bool true if all parent, root and service links are correct
+	 *
+	 * Intended for debugging, for example after many devices have been added or removed.
+	 * Any problems are reported via debug output.
+	 */
+	bool validateTree();
+
+	const FlashString* writeDescription(XmlWriter& writer, DescType descType) override;
 
 	ItemEnumerator* getList(unsigned index, String& name) override;
 
 	void sendXml(HttpResponse& response, IDataSourceStream* content);
 
+	/**
+	 * @brief Send the description for this device or one of its services
+	 * @param connection
+	 * @param object This device, or one of its services
+	 * @note A pre-compressed description is sent if available and the client accepts gzip encoding.
+	 * Conditional requests are handled, so '304 Not Modified' may be sent instead.
+	 */
+	void sendDescription(HttpServerConnection& connection, Object& object);
+
 private:
+	friend class TreeWalker;
+
+	void setRoot(RootDevice* root);
+	bool validateTree(Device* parent, RootDevice* root, unsigned depth);
+
 	ServiceList services_;
 	DeviceList devices_;
 	Device* parent_{nullptr};
+	RootDevice* root_{nullptr};
 };
 
 } // namespace UPnP
@@ -21,6 +21,42 @@
 
 #include "RootDevice.h"
 #include "ControlPoint.h"
+#include "SearchIndex.h"
+#include "TreeWalker.h"
+#include "MessageScheduler.h"
+#include "HeaderCache.h"
+#include "RateLimiter.h"
+#include <Timer.h>
+
+/**
+ * @brief Period (in seconds) over which all registered devices are re-advertised
+ * @note Must be less than half the CACHE-CONTROL max-age value sent by the SSDP server (1800)
+ */
+#ifndef UPNP_ADVERTISE_INTERVAL
+#define UPNP_ADVERTISE_INTERVAL 800
+#endif
+
+/**
+ * @brief Maximum time (in microseconds) spent searching devices per task callback
+ */
+#ifndef UPNP_SEARCH_TIME_BUDGET
+#define UPNP_SEARCH_TIME_BUDGET 2000
+#endif
+
+/**
+ * @brief How far ahead (in milliseconds) of their due time queued search responses and notifications
+ * are passed to the scheduler
+ */
+#ifndef UPNP_SEARCH_LOOKAHEAD
+#define UPNP_SEARCH_LOOKAHEAD 200
+#endif
+
+/**
+ * @brief Number of searches and announcements in progress which can be allocated without using the heap
+ */
+#ifndef UPNP_SEARCH_POOL_SIZE
+#define UPNP_SEARCH_POOL_SIZE 4
+#endif
 
 namespace UPnP
 {
@@ -36,9 +72,58 @@ public:
 
 	bool isActive() const;
 
-	bool registerDevice(RootDevice* device);
+	/**
+	 * @brief Callback invoked when a device has finished being added or removed
+	 * @param device
+	 * @param registered true if device was registered, false if removed
+	 * @param success false if some announcements could not be sent, for example because
+	 * the message pool was full or the operation was cancelled
+	 * @note When a device is removed, this is called after the final 'ssdp:byebye' announcement
+	 * has been sent. The application may then safely destroy the device.
+	 */
+	using DeviceCallback = Delegate<void(RootDevice& device, bool registered, bool success)>;
+
+	/**
+	 * @brief Add a root device and advertise it
+	 * @param device
+	 * @param callback Invoked when all 'ssdp:alive' announcements have been sent
+	 * @retval bool false if device is invalid
+	 * @note If the device is already registered the callback is invoked immediately
+	 */
+	bool registerDevice(RootDevice* device, DeviceCallback callback = nullptr);
+
+	/**
+	 * @brief Remove a root device
+	 * @param device
+	 * @param callback Invoked when all 'ssdp:byebye' announcements have been sent
+	 * @retval bool false if device was not registered
+	 * @note Device stops responding to requests immediately
+	 */
+	bool unRegisterDevice(RootDevice* device, DeviceCallback callback = nullptr);
+
+	/**
+	 * @brief Add a number of root devices
+	 * @param devices Array of devices
+	 * @param count Number of devices in array
+	 * @param callback Invoked for each device when its announcements have been sent
+	 * @retval unsigned Number of devices registered
+	 *
+	 * Devices respond to requests immediately, but announcements are paced so that
+	 * large numbers of devices can be added without flooding the network or exhausting
+	 * the message pool.
+	 */
+	unsigned registerDevices(RootDevice* const* devices, unsigned count, DeviceCallback callback = nullptr);
+
+	/**
+	 * @brief Remove a number of root devices
+	 * @param devices Array of devices
+	 * @param count Number of devices in array
+	 * @param callback Invoked for each device when its announcements have been sent
+	 * @retval unsigned Number of devices removed
+	 */
+	unsigned unRegisterDevices(RootDevice* const* devices, unsigned count, DeviceCallback callback = nullptr);
 
-	bool unRegisterDevice(RootDevice* device);
+	bool isRegistered(const RootDevice* device);
 
 	bool registerControlPoint(ControlPoint* cp)
 	{
@@ -62,16 +147,207 @@ public:
 		return rootDevices.head();
 	}
 
-	void notify(Device* device, NotifySubtype subype);
+	/**
+	 * @brief Schedule notifications for a device, its embedded devices and services
+	 * @retval bool false if out of memory
+	 * @note As with searches, the device tree is processed over several task callbacks
+	 */
+	bool notify(Device* device, NotifySubtype subype);
 
-private:
+	/**
+	 * @brief Inform host that a device tree has changed
+	 * @param device Any device within the tree
+	 *
+	 * Called by the framework when devices or services are added or removed.
+	 * Applications must also call this if they change any fields used for searching
+	 * or advertising (e.g. UDN, deviceType, serviceType, serverId or URLs)
+	 * after the device has been registered, or if field caching is enabled.
+	 * Any memoized field values for the tree are discarded.
+	 */
+	void deviceChanged(Device* device);
+
+	/**
+	 * @brief Get scheduler for outgoing messages, e.g. to inspect statistics
+	 */
+	const MessageScheduler& getScheduler() const
+	{
+		return scheduler;
+	}
+
+	MessageScheduler& getScheduler()
+	{
+		return scheduler;
+	}
+
+	/**
+	 * @brief Get usage of the pool for searches and announcements in progress
+	 * @note `failures` counts those allocated from the heap instead
+	 */
+	static ObjectPoolStats getSearchPoolStats()
+	{
+		return searchPool.getStats();
+	}
+
+	/**
+	 * @brief Get M-SEARCH rate limiter, e.g. to change configuration or inspect statistics
+	 */
+	RateLimiter& getRateLimiter()
+	{
+		return rateLimiter;
+	}
+
+	/**
+	 * @brief Get cache of formatted SSDP headers, used by objects without field caching when formatting messages
+	 */
+	HeaderCache& getHeaderCache()
+	{
+		return headerCache;
+	}
+
+	/**
+	 * @brief Handle an incoming M-SEARCH request
+	 *
+	 * Called by the SSDP server. Applications may also use this to inject requests,
+	 * for example when testing or benchmarking.
+	 */
 	void onSearchRequest(const BasicMessage& request);
 
-	void search(SearchFilter& filter, Device* device);
+	/**
+	 * @brief Determine whether any searches or notifications are waiting to be completed
+	 */
+	bool isSearching() const
+	{
+		return searches != nullptr;
+	}
+
+	/**
+	 * @brief Continue processing queued searches and notifications, up to the configured time budget
+	 *
+	 * Normally called via the task queue. Applications may call this directly to complete
+	 * searches, for example when benchmarking.
+	 */
+	void processSearches();
+
+	/**
+	 * @brief Set maximum time spent searching devices per task callback
+	 * @param budgetUs Time in microseconds
+	 * @note At least one device or service is searched per callback
+	 */
+	void setSearchTimeBudget(uint32_t budgetUs)
+	{
+		searchTimeBudget = budgetUs;
+	}
+
+	/**
+	 * @brief Set how far ahead of their due time queued messages are passed to the scheduler
+	 * @param lookaheadMs Time in milliseconds
+	 * @note Searches and notifications are paused until their next message falls within this window,
+	 * and while the message pool is three-quarters full. Messages are then sent late rather than dropped.
+	 */
+	void setSearchLookahead(uint32_t lookaheadMs)
+	{
+		searchLookahead = lookaheadMs;
+	}
+
+private:
+	struct SearchCursor;
+
+	/**
+	 * @brief Pending or active device registration/removal
+	 */
+	struct DeviceOp {
+		DeviceOp* next;
+		RootDevice* device;
+		DeviceCallback callback;
+		NotifySubtype subtype;
+		SearchCursor* cursor; ///< Announcements still being scheduled
+		uint16_t id;		  ///< Tag for scheduled messages
+		uint16_t outstanding; ///< Messages not yet sent
+		bool active;		  ///< Announcements have been started
+		bool failed;		  ///< Some announcements were dropped
+	};
+
+	/**
+	 * @brief Search or notification, processed one object at a time over several task callbacks
+	 */
+	struct SearchCursor {
+		SearchCursor(const MessageSpec& spec, uint32_t delayMs) : ms(spec), filter(ms, delayMs)
+		{
+		}
+
+		SearchCursor* next{nullptr};
+		MessageSpec ms;
+		SearchFilter filter;
+		TreeWalker walker;
+		DeviceOp* op{nullptr}; ///< Registration or removal these announcements are for
+		uint32_t startTime{0}; ///< Time of request, in milliseconds
+		uint32_t windowMs{0};
+		uint32_t slotMs{0};
+		unsigned matchCount{0};
+		unsigned index{0}; ///< Matches processed so far
+		unsigned scheduled{0};
+		unsigned dropped{0};  ///< Messages discarded because the pool was full
+		bool counted{false}; ///< Number of matches is known
+
+		/*
+		 * One is created for every M-SEARCH and announcement, so use a fixed pool
+		 * to avoid heap churn, falling back to the heap if it's exhausted
+		 */
+		static void* operator new(size_t size);
+		static void operator delete(void* ptr);
+	};
+
+	using SearchPool = ObjectPool<SearchCursor, UPNP_SEARCH_POOL_SIZE>;
+	static SearchPool searchPool;
+
+	/**
+	 * @brief Schedule messages for all indexed matches, spread evenly across a time window
+	 * @param filter
+	 * @param matchCount Number of matches in the index
+	 * @param windowMs Period over which messages are to be sent, following `filter.delayMs`
+	 * @retval unsigned Number of messages scheduled
+	 */
+	unsigned search(SearchFilter& filter, unsigned matchCount, uint32_t windowMs);
+
+	void queueSearch(SearchCursor* cursor, Device* device);
+	SearchCursor* queueNotify(Device* device, NotifySubtype subtype);
+	void updateSearchIndex();
+	unsigned getPoolHeadroom() const;
+	uint32_t getSearchWait(const SearchCursor& cursor) const;
+	bool continueSearch(SearchCursor& cursor);
+	void startResponses(SearchCursor& cursor);
+	void finishSearch(SearchCursor* cursor);
+
+	bool queueDeviceOp(RootDevice* device, NotifySubtype subtype, DeviceCallback callback);
+	void processDeviceOps();
+	void completeDeviceOp(DeviceOp* op);
+	DeviceOp* findDeviceOp(MessageScheduler::Tag tag);
+	void messageSent(MessageScheduler::Tag tag);
+	void messageDropped(MessageScheduler::Tag tag);
+
+	void scheduleAdvertisement(uint32_t delayMs);
+	void onAdvertTimer();
 
 private:
 	RootDeviceList rootDevices;
 	ControlPointList controlPoints;
+	SearchIndex searchIndex;
+	MessageScheduler scheduler;
+	HeaderCache headerCache{UPNP_HEADER_CACHE_SIZE};
+	RateLimiter rateLimiter;
+	Timer advertTimer;
+	Timer deviceOpTimer;
+	Timer searchTimer;
+	DeviceOp* deviceOps{nullptr};
+	DeviceOp* deviceOpTail{nullptr};
+	uint16_t lastOpId{0};
+	SearchCursor* searches{nullptr};
+	SearchCursor* searchTail{nullptr};
+	uint32_t searchTimeBudget{UPNP_SEARCH_TIME_BUDGET};
+	uint32_t searchLookahead{UPNP_SEARCH_LOOKAHEAD};
+	bool searchTaskQueued{false};
+	bool searchIndexStale{false}; ///< Rebuild index before next use
+	uint16_t advertIndex{0}; ///< Next root device to be re-advertised
 };
 
 extern DeviceHost deviceHost;
@@ -49,7 +49,7 @@ public:
 
 	/**
 	 * @brief Reset enumerator to start of list
-	 * @note Call to `next()` will return first item
+	 * @note `current()` then returns the first item
 	 */
 	virtual void reset() = 0;
 
@@ -0,0 +1,85 @@
+/**
+ * FieldCache.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <WString.h>
+#include <Print.h>
+
+namespace UPnP
+{
+/**
+ * @brief Compact store for memoized object field values
+ *
+ * Values are packed into a single heap block, each prefixed by its field index.
+ * Fields which have no value (i.e. `getField()` returned nullptr) are recorded
+ * without storage. Up to 32 fields are supported.
+ */
+class FieldCache
+{
+public:
+	~FieldCache()
+	{
+		free(data);
+	}
+
+	/**
+	 * @brief Look up a cached field value
+	 * @param index Field index
+	 * @param value On success, receives the cached value
+	 * @retval bool true if value was cached
+	 */
+	bool get(unsigned index, String& value) const;
+
+	/**
+	 * @brief Print a cached field value
+	 * @param index Field index
+	 * @param p Output
+	 * @param count On success, receives the number of characters written
+	 * @retval bool true if value was cached
+	 */
+	bool print(unsigned index, Print& p, size_t& count) const;
+
+	/**
+	 * @brief Store a field value
+	 * @param index Field index
+	 * @param value Value to store, may be nullptr
+	 */
+	void set(unsigned index, const String& value);
+
+	/**
+	 * @brief Discard all values
+	 */
+	void clear();
+
+	bool isEmpty() const
+	{
+		return cached == 0;
+	}
+
+private:
+	const char* find(unsigned index) const;
+
+	char* data{nullptr}; ///< Entries: index byte followed by NUL-terminated value
+	uint16_t length{0};
+	uint32_t cached{0}; ///< Bitmask of cached fields
+	uint32_t nulls{0};  ///< Bitmask of cached fields with no value
+};
+
+} // namespace UPnP
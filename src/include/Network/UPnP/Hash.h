@@ -0,0 +1,72 @@
+/**
+ * Hash.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <WString.h>
+
+namespace UPnP
+{
+/**
+ * @brief 32-bit FNV-1a hash
+ *
+ * Used for fast comparison of search targets and other strings.
+ * The `hash` parameter allows a hash to be built up from several pieces,
+ * giving the same result as hashing the concatenated string.
+ */
+namespace Hash
+{
+constexpr uint32_t initial{2166136261U};
+constexpr uint32_t prime{16777619U};
+
+inline uint32_t fnv1a(const void* data, size_t length, uint32_t hash = initial)
+{
+	auto p = static_cast<const uint8_t*>(data);
+	while(length-- != 0) {
+		hash = (hash ^ *p++) * prime;
+	}
+	return hash;
+}
+
+inline uint32_t fnv1a(char c, uint32_t hash = initial)
+{
+	return (hash ^ uint8_t(c)) * prime;
+}
+
+inline uint32_t fnv1a(const String& s, uint32_t hash = initial)
+{
+	return fnv1a(s.c_str(), s.length(), hash);
+}
+
+/**
+ * @brief Hash a NUL-terminated string
+ * @note Evaluated at compile time for literals, so may be used for `case` labels
+ */
+constexpr uint32_t fnv1a(const char* s)
+{
+	uint32_t hash{initial};
+	while(*s != '\0') {
+		hash = (hash ^ uint8_t(*s++)) * prime;
+	}
+	return hash;
+}
+
+} // namespace Hash
+
+} // namespace UPnP
@@ -0,0 +1,125 @@
+/**
+ * HeaderCache.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <Network/SSDP/Message.h>
+#include <Network/SSDP/MessageSpec.h>
+#include <WString.h>
+
+/**
+ * @brief Number of pre-formatted SSDP header blocks shared by objects without field caching
+ */
+#ifndef UPNP_HEADER_CACHE_SIZE
+#define UPNP_HEADER_CACHE_SIZE 8
+#endif
+
+namespace UPnP
+{
+using namespace SSDP;
+
+class Object;
+
+/**
+ * @brief Cache of formatted SSDP header values, keyed by object, search match and interface
+ *
+ * SERVER, LOCATION, NT/ST and USN values rarely change but are expensive to build,
+ * requiring several `getField()` calls and URL formatting.
+ *
+ * Objects with field caching enabled keep their own cache, alongside their field values,
+ * which holds a block for each search match and interface. Others share a small cache owned
+ * by `DeviceHost`. Either way, entries are allocated as required up to a fixed limit,
+ * after which the least-recently used entry is replaced.
+ *
+ * LOCATION depends on the interface used, so entries are also keyed by local IP address.
+ * Entries for an old address are never matched and are replaced in the normal way.
+ * The cache must be cleared if fields change: `DeviceHost::deviceChanged()` does this.
+ */
+class HeaderCache
+{
+public:
+	/**
+	 * @param maxEntries Limit on number of blocks to store
+	 */
+	HeaderCache(unsigned maxEntries) : maxEntries(maxEntries)
+	{
+	}
+
+	~HeaderCache()
+	{
+		clear();
+	}
+
+	class Entry
+	{
+	public:
+		/**
+		 * @brief Copy header values into a message
+		 * @note Sets NT for notifications, otherwise ST
+		 */
+		void apply(Message& msg) const;
+
+	private:
+		const char* value(unsigned index) const
+		{
+			return values.c_str() + (index == 0 ? 0 : offsets[index - 1]);
+		}
+
+		friend class HeaderCache;
+		Entry* next{nullptr};
+		Object* object{nullptr};
+		IpAddress localIp;
+		uint32_t lastUsed{0};
+		SearchMatch match{};
+		String values;		 ///< SERVER, LOCATION, ST, USN values, NUL-separated
+		uint16_t offsets[3]; ///< Start of LOCATION, ST, USN within `values`
+	};
+
+	/**
+	 * @brief Copy header values into a message
+	 * @note Sets NT for notifications, otherwise ST
+	 */
+	static void apply(Message& msg, const char* server, const char* location, const char* st, const char* usn);
+
+	/**
+	 * @brief Find a cached header block
+	 * @retval Entry* nullptr if not cached, or out of date
+	 */
+	const Entry* find(Object* object, SearchMatch match, IpAddress localIp);
+
+	/**
+	 * @brief Store a header block, replacing the least-recently used entry if the cache is full
+	 * @retval Entry* nullptr if the cache has no entries and one cannot be allocated
+	 */
+	const Entry* add(Object* object, SearchMatch match, IpAddress localIp, const String& server,
+					 const String& location, const String& st, const String& usn);
+
+	/**
+	 * @brief Discard all entries
+	 */
+	void clear();
+
+private:
+	Entry* head{nullptr};
+	uint32_t useCount{0};
+	uint16_t count{0};
+	uint16_t maxEntries;
+};
+
+} // namespace UPnP
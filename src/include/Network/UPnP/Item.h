@@ -19,12 +19,14 @@
 
 #pragma once
 
+#include <FlashString/String.hpp>
 #include <RapidXML.h>
 
 namespace UPnP
 {
 class Item;
 class ItemEnumerator;
+class XmlWriter;
 
 /**
  * @brief When building descriptions this qualifies what information is required
@@ -42,11 +44,24 @@ public:
 	{
 	}
 
-	virtual XML::Node* getDescription(XML::Document& doc, DescType descType)
+	/**
+	 * @brief Write description content, leaving the main element open
+	 * @param writer
+	 * @param descType
+	 * @retval const FlashString* Name of the element to be closed, nullptr if nothing was written
+	 * @note The element is closed by DescriptionStream after any lists have been written
+	 */
+	virtual const FlashString* writeDescription(XmlWriter& writer, DescType descType)
 	{
 		return nullptr;
 	}
 
+	/**
+	 * @deprecated Descriptions are no longer built as documents: override `writeDescription()` instead.
+	 * Any existing override fails to compile, rather than being silently ignored.
+	 */
+	virtual XML::Node* getDescription(XML::Document& doc, DescType descType) final = delete;
+
 	virtual ItemEnumerator* getList(unsigned index, String& name)
 	{
 		return nullptr;
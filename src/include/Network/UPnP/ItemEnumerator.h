@@ -21,6 +21,7 @@
 
 #include "Enumerator.h"
 #include "Item.h"
+#include "ObjectPool.h"
 
 namespace UPnP
 {
@@ -67,6 +68,17 @@ public:
 		return current_;
 	}
 
+	/**
+	 * @brief Enumerators are allocated from a fixed pool, falling back to the heap if it's exhausted
+	 *
+	 * One is created for every list whilst streaming a description,
+	 * so this avoids heap churn when several descriptions are requested at once.
+	 */
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
+	static ObjectPoolStats getPoolStats();
+
 private:
 	Item* head_;
 	Item* current_{nullptr};
@@ -41,9 +41,20 @@ public:
 		return next_;
 	}
 
+	/**
+	 * @brief Get the list this item belongs to
+	 * @retval LinkedItemList* nullptr if item is not in a list
+	 */
+	LinkedItemList* getOwner() const
+	{
+		return owner_;
+	}
+
 private:
 	friend class LinkedItemList;
 	LinkedItem* next_{nullptr};
+	LinkedItem* prev_{nullptr};
+	LinkedItemList* owner_{nullptr};
 };
 
 } // namespace UPnP
@@ -24,22 +24,68 @@
 namespace UPnP
 {
 /**
- * @brief Singly-linked list of objects
+ * @brief Intrusive doubly-linked list of objects
+ *
+ * Items record which list they belong to, so membership checks, appending and removal
+ * are all O(1). An item may only be in one list at a time.
  */
 class LinkedItemList
 {
 public:
+	/**
+	 * @brief Items still in the list are released so they may be added to another one
+	 */
+	~LinkedItemList()
+	{
+		clear();
+	}
+
+	/**
+	 * @brief Append an item to the list
+	 * @retval bool true if item is now in this list, false if it is null or belongs to another list
+	 */
 	bool add(LinkedItem* item);
 
+	/**
+	 * @brief Remove an item from the list
+	 * @retval bool false if item is not in this list
+	 */
 	bool remove(LinkedItem* item);
 
+	/**
+	 * @brief Remove all items from the list
+	 */
+	void clear();
+
+	bool contains(const LinkedItem* item) const
+	{
+		return item != nullptr && item->owner_ == this;
+	}
+
 	LinkedItem* head()
 	{
 		return head_;
 	}
 
+	LinkedItem* tail()
+	{
+		return tail_;
+	}
+
+	unsigned count() const
+	{
+		return count_;
+	}
+
+	bool isEmpty() const
+	{
+		return head_ == nullptr;
+	}
+
 private:
 	LinkedItem* head_{nullptr};
+	LinkedItem* tail_{nullptr};
+	unsigned count_{0};
 };
 
 } // namespace UPnP
@@ -0,0 +1,179 @@
+/**
+ * MessageScheduler.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Object.h"
+#include "ObjectPool.h"
+#include <Timer.h>
+
+/**
+ * @brief Maximum number of messages which may be pending at any one time
+ */
+#ifndef UPNP_MESSAGE_POOL_SIZE
+#define UPNP_MESSAGE_POOL_SIZE 32
+#endif
+
+namespace UPnP
+{
+/**
+ * @brief Holds outgoing SSDP messages until they're due to be sent
+ *
+ * Messages are passed to the SSDP server queue when due, but no more than `maxInFlight` at a time.
+ * A record is kept of those until they're sent, so they can still be cancelled if their object is removed.
+ * Keeping them here until then allows duplicate search responses to be detected:
+ * control points typically send an M-SEARCH two or three times in quick succession,
+ * and we only need to answer each one once.
+ *
+ * Pending messages are stored in a fixed-size pool to avoid heap fragmentation.
+ * If the pool is exhausted then further messages are discarded and counted: control points will
+ * repeat their searches, and notifications are periodically re-sent.
+ * `DeviceHost` avoids this by passing messages here only shortly before they're due.
+ */
+class MessageScheduler
+{
+public:
+	struct Stats {
+		uint32_t scheduled;  ///< Messages accepted
+		uint32_t suppressed; ///< Duplicate responses merged into a pending one
+		uint32_t dropped;	///< Messages discarded because the pool was full
+	};
+
+	enum class Result {
+		scheduled, ///< Message added
+		merged,	///< Identical response already pending
+		dropped,   ///< Pool exhausted
+	};
+
+	using PoolStats = ObjectPoolStats;
+
+	/**
+	 * @brief Identifies the caller a message was scheduled for, 0 if untagged
+	 */
+	using Tag = uint16_t;
+
+	MessageScheduler();
+
+	~MessageScheduler()
+	{
+		clear();
+	}
+
+	/**
+	 * @brief Schedule a message for sending
+	 * @param spec Specification for the message
+	 * @param delayMs How long to wait before sending
+	 * @param tag Returned by `confirmSend()` and passed to `remove()` predicate for this message.
+	 * A merged response keeps the tag it was first scheduled with.
+	 * @retval Result
+	 */
+	Result schedule(const MessageSpec& spec, uint32_t delayMs, Tag tag = 0);
+
+	using Predicate = Delegate<bool(const MessageSpec& spec, Tag tag)>;
+
+	/**
+	 * @brief Discard pending messages
+	 * @param predicate Returns true for messages to be removed
+	 * @retval unsigned Number of messages removed
+	 * @note Messages already passed to the SSDP server are cancelled, and included in the count
+	 */
+	unsigned remove(Predicate predicate);
+
+	/**
+	 * @brief Called by the SSDP server send callback before a message is formatted
+	 * @param spec As passed to the callback
+	 * @param tag On return, the tag the message was scheduled with
+	 * @retval bool false if the message was cancelled, so must not be sent.
+	 * Its object may no longer exist.
+	 */
+	bool confirmSend(const MessageSpec& spec, Tag& tag);
+
+	/**
+	 * @brief Discard all pending messages
+	 */
+	void clear();
+
+	/**
+	 * @brief Get number of messages waiting to be sent
+	 */
+	unsigned count() const
+	{
+		return count_;
+	}
+
+	const Stats& getStats() const
+	{
+		return stats;
+	}
+
+	/**
+	 * @brief Get usage of the message pool
+	 * @note `failures` counts messages discarded because the pool was full
+	 */
+	PoolStats getPoolStats() const
+	{
+		return pool.getStats();
+	}
+
+	/**
+	 * @brief Set maximum number of messages passed to the SSDP server queue at any one time
+	 * @note Messages are held here until there's space. Defaults to UPNP_MAX_INFLIGHT.
+	 */
+	void setMaxInFlight(uint8_t count)
+	{
+		maxInFlight = std::max(count, uint8_t(1));
+	}
+
+private:
+	struct Entry {
+		Entry(const MessageSpec& spec, uint32_t due, Tag tag) : spec(spec), due(due), tag(tag)
+		{
+		}
+
+		Entry* next{nullptr};
+		Entry* prev{nullptr};
+		MessageSpec spec;
+		uint32_t due;					  ///< Time (in milliseconds) when message should be sent
+		Tag tag;
+		const MessageSpec* sent{nullptr}; ///< Copy held by the SSDP server queue
+		bool cancelled{false};
+	};
+
+	using Pool = ObjectPool<Entry, UPNP_MESSAGE_POOL_SIZE>;
+
+	Entry* findDuplicate(const MessageSpec& spec);
+	void insert(Entry* entry);
+	void insertAfter(Entry* prev, Entry* entry);
+	void unlink(Entry* entry);
+	void startTimer();
+	void onTimer();
+	void releaseInFlight(const MessageSpec* sent);
+
+private:
+	Entry* head{nullptr};
+	Entry* tail{nullptr};
+	Entry* inFlight{nullptr}; ///< Passed to SSDP server, not yet sent
+	uint16_t count_{0};
+	uint8_t maxInFlight;
+	Stats stats{};
+	Pool pool;
+	Timer timer;
+};
+
+} // namespace UPnP
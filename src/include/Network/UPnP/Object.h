@@ -20,6 +20,9 @@
 #pragma once
 
 #include "LinkedItem.h"
+#include "FieldCache.h"
+#include "HeaderCache.h"
+#include "DescriptionCache.h"
 #include <WString.h>
 #include <Delegate.h>
 #include <Network/SSDP/MessageSpec.h>
@@ -27,6 +30,7 @@
 #include <Network/Http/HttpServerConnection.h>
 #include <Network/Http/HttpRequest.h>
 #include <Network/Http/HttpResponse.h>
+#include <memory>
 
 namespace UPnP
 {
@@ -42,10 +46,11 @@ struct SearchFilter {
 	{
 	}
 
-	const MessageSpec& ms; ///< Specification for message to be sent
-	uint32_t delayMs;	  ///< Message delay
-	String targetString;   ///< Full search target value
-	Callback callback;	 ///< Called on a match
+	const MessageSpec& ms;  ///< Specification for message to be sent
+	uint32_t delayMs;		///< Message delay
+	String targetString;	///< Full search target value
+	uint32_t targetHash{0}; ///< Hash of targetString, if set
+	Callback callback;		///< Called on a match
 };
 
 class Object : public LinkedItem
@@ -63,6 +68,28 @@ public:
 	 */
 	virtual void search(const SearchFilter& filter) = 0;
 
+	/**
+	 * @brief Get the search target string which identifies this object for a given match
+	 * @param match
+	 * @retval String The ST/NT value, e.g. "urn:schemas-upnp-org:device:Basic:1"
+	 */
+	virtual String getTargetString(SearchMatch match)
+	{
+		return nullptr;
+	}
+
+	/**
+	 * @brief Determine whether a search target identifies this object
+	 * @param match
+	 * @param target The ST value
+	 * @retval bool
+	 * @note Objects may override this to avoid building the target string
+	 */
+	virtual bool matchTarget(SearchMatch match, const String& target)
+	{
+		return target == getTargetString(match);
+	}
+
 	/**
 	 * @brief Standard fields have been completed
 	 * @note Fields can be modified typically by adding any custom fields
@@ -98,6 +125,63 @@ public:
 	 */
 	virtual IDataSourceStream* createDescription();
 
+	/**
+	 * @brief Called by framework to obtain a gzip-compressed description
+	 * @retval IDataSourceStream* nullptr if not available
+	 *
+	 * Where a fixed description is provided, for example one imported into flash,
+	 * a pre-compressed version may also be provided. This is sent to clients which accept it.
+	 */
+	virtual IDataSourceStream* createCompressedDescription()
+	{
+		return nullptr;
+	}
+
+	/**
+	 * @brief Get the description to be sent in response to a request
+	 * @retval IDataSourceStream* From the description cache if enabled, otherwise `createDescription()`
+	 * @note If the cache is out of date, the whole description is rendered into it before this returns.
+	 * For a large tree this can hold up the HTTP server for some time.
+	 */
+	IDataSourceStream* getDescriptionStream();
+
+	/**
+	 * @brief Keep the rendered description so repeated requests don't walk the object tree
+	 * @param enable
+	 *
+	 * The description is rendered on first request, and again after the root device's
+	 * description version changes: see `DeviceHost::deviceChanged()`.
+	 */
+	virtual void enableDescriptionCache(bool enable);
+
+	bool isDescriptionCacheEnabled() const
+	{
+		return bool(descriptionCache);
+	}
+
+	/**
+	 * @brief Enable memoization of field values
+	 * @param enable
+	 *
+	 * When enabled, values obtained using `getCachedField()` are stored on first use.
+	 * This is worthwhile where fields are built from other fields, such as URLs and type strings.
+	 * Formatted SSDP headers are also kept for each search match and interface.
+	 * Values must then be invalidated if they change: see `invalidateFields()`.
+	 */
+	virtual void enableFieldCache(bool enable);
+
+	bool isFieldCacheEnabled() const
+	{
+		return bool(fieldCache);
+	}
+
+	/**
+	 * @brief Discard memoized field values
+	 *
+	 * Called automatically via `DeviceHost::deviceChanged()` when the device tree changes.
+	 */
+	virtual void invalidateFields();
+
 	/**
 	 * @brief Split a device or service type string into `deviceType` and `version`
 	 * @param type e.g. "Basic:1", on return gets reduced to "Basic"
@@ -111,6 +195,11 @@ public:
 	 * @retval The version "1", or nullptr if not present
 	 */
 	static const char* getTypeVersion(const char* type);
+
+protected:
+	std::unique_ptr<FieldCache> fieldCache;
+	std::unique_ptr<HeaderCache> headerCache;
+	std::unique_ptr<DescriptionCache> descriptionCache;
 };
 
 /**
@@ -24,7 +24,7 @@
 namespace UPnP
 {
 /**
- * @brief Class template for singly-linked list of objects
+ * @brief Class template for linked list of objects
  */
 template <typename ObjectType> class ObjectList : public LinkedItemList
 {
@@ -33,6 +33,11 @@ public:
 	{
 		return reinterpret_cast<ObjectType*>(LinkedItemList::head());
 	}
+
+	ObjectType* tail()
+	{
+		return reinterpret_cast<ObjectType*>(LinkedItemList::tail());
+	}
 };
 
 } // namespace UPnP
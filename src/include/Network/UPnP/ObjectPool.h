@@ -0,0 +1,140 @@
+/**
+ * ObjectPool.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <new>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace UPnP
+{
+struct ObjectPoolStats {
+	uint16_t capacity; ///< Total number of slots
+	uint16_t used;	 ///< Slots currently in use
+	uint16_t peak;	 ///< High-water mark for `used`
+	uint32_t failures; ///< Number of times the pool was exhausted
+};
+
+/**
+ * @brief Fixed-capacity storage for objects of one type
+ *
+ * Avoids heap fragmentation caused by many small, short-lived allocations.
+ * Free slots are kept in a singly-linked list so allocation and release are O(1).
+ */
+template <typename T, uint16_t capacity_> class ObjectPool
+{
+public:
+	using Stats = ObjectPoolStats;
+
+	ObjectPool()
+	{
+		for(unsigned i = 0; i < capacity_; ++i) {
+			slots[i].next = (i + 1 < capacity_) ? &slots[i + 1] : nullptr;
+		}
+		freeList = &slots[0];
+	}
+
+	/**
+	 * @brief Construct an object in the pool
+	 * @retval T* nullptr if pool is exhausted
+	 */
+	template <typename... Args> T* create(Args&&... args)
+	{
+		auto storage = allocate();
+		return (storage == nullptr) ? nullptr : new(storage) T(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * @brief Destroy an object and return its slot to the pool
+	 */
+	void destroy(T* object)
+	{
+		if(object == nullptr) {
+			return;
+		}
+
+		object->~T();
+		release(object);
+	}
+
+	/**
+	 * @brief Obtain uninitialised storage for an object
+	 * @retval void* nullptr if pool is exhausted
+	 * @note Used to implement class-specific `operator new`
+	 */
+	void* allocate()
+	{
+		if(freeList == nullptr) {
+			++stats.failures;
+			return nullptr;
+		}
+
+		auto slot = freeList;
+		freeList = slot->next;
+		if(++stats.used > stats.peak) {
+			stats.peak = stats.used;
+		}
+		return slot->storage;
+	}
+
+	/**
+	 * @brief Return storage obtained via `allocate()` to the pool
+	 */
+	void release(void* storage)
+	{
+		auto slot = static_cast<Slot*>(storage);
+		slot->next = freeList;
+		freeList = slot;
+		--stats.used;
+	}
+
+	/**
+	 * @brief Determine if an object lives in this pool
+	 */
+	bool contains(const void* object) const
+	{
+		return object >= &slots[0] && object < &slots[capacity_];
+	}
+
+	Stats getStats() const
+	{
+		Stats s = stats;
+		s.capacity = capacity_;
+		return s;
+	}
+
+	void resetPeak()
+	{
+		stats.peak = stats.used;
+	}
+
+private:
+	union Slot {
+		Slot* next;
+		alignas(T) uint8_t storage[sizeof(T)];
+	};
+
+	Slot slots[capacity_];
+	Slot* freeList;
+	Stats stats{};
+};
+
+} // namespace UPnP
@@ -0,0 +1,124 @@
+/**
+ * RateLimiter.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <IpAddress.h>
+
+/**
+ * @brief Number of remote addresses tracked for M-SEARCH rate limiting
+ */
+#ifndef UPNP_RATELIMIT_SOURCES
+#define UPNP_RATELIMIT_SOURCES 8
+#endif
+
+namespace UPnP
+{
+/**
+ * @brief Protects against M-SEARCH floods
+ *
+ * Each remote IP address has a token bucket which limits how often it may search.
+ * There is also a global budget for the number of responses generated.
+ *
+ * Checks are made before any search is performed so excess requests are dropped cheaply.
+ */
+class RateLimiter
+{
+public:
+	struct Config {
+		uint16_t sourceRate;	///< Searches per second allowed from each remote address
+		uint16_t sourceBurst;   ///< Maximum burst of searches from each remote address
+		uint16_t responseRate;  ///< Responses per second allowed in total
+		uint16_t responseBurst; ///< Maximum burst of responses in total
+	};
+
+	struct Stats {
+		uint32_t accepted;		///< Requests passed for searching
+		uint32_t droppedSource; ///< Requests dropped because the remote address exceeded its rate
+		uint32_t droppedGlobal; ///< Requests dropped because the response budget was exhausted
+	};
+
+	RateLimiter();
+
+	void configure(const Config& config);
+
+	const Config& getConfig() const
+	{
+		return config;
+	}
+
+	/**
+	 * @brief Enable or disable rate limiting
+	 * @note When disabled all requests are accepted. Intended for testing and benchmarking.
+	 */
+	void setEnabled(bool state)
+	{
+		enabled = state;
+	}
+
+	bool isEnabled() const
+	{
+		return enabled;
+	}
+
+	/**
+	 * @brief Determine whether a search request should be processed
+	 * @param remoteIp Source of the request
+	 * @retval bool true to accept, false to drop
+	 */
+	bool allowRequest(IpAddress remoteIp);
+
+	/**
+	 * @brief Charge responses generated by an accepted request against the global budget
+	 */
+	void consumeResponses(unsigned count);
+
+	const Stats& getStats() const
+	{
+		return stats;
+	}
+
+private:
+	/*
+	 * Tokens are stored in thousandths so a rate in tokens per second
+	 * is also the refill rate in milli-tokens per millisecond.
+	 */
+	struct Bucket {
+		int32_t tokens;
+		uint32_t lastUpdate;
+
+		void refill(uint32_t now, uint16_t rate, uint16_t burst);
+	};
+
+	struct Source {
+		IpAddress ip;
+		Bucket bucket;
+	};
+
+	Source* findSource(IpAddress ip, uint32_t now);
+
+private:
+	Config config;
+	Stats stats{};
+	Bucket responses;
+	Source sources[UPNP_RATELIMIT_SOURCES]{};
+	bool enabled{true};
+};
+
+} // namespace UPnP
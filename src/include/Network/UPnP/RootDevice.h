@@ -22,6 +22,13 @@
 #include "Device.h"
 #include <Network/SSDP/Message.h>
 
+/**
+ * @brief Number of network interfaces for which a root device caches its base URL
+ */
+#ifndef UPNP_URL_CACHE_SIZE
+#define UPNP_URL_CACHE_SIZE 2
+#endif
+
 namespace UPnP
 {
 struct SpecVersion {
@@ -44,11 +51,29 @@ public:
 
 	Url getURL(const String& path);
 
+	/**
+	 * @brief Get the absolute URL for a path, as seen on a given interface
+	 * @param path Absolute path, e.g. from `getField(Field::descriptionURL)`
+	 * @param localIp Address of interface, see `getLocalIp()`
+	 * @retval String e.g. "http://192.168.1.10/uuid/desc.xml"
+	 *
+	 * The base part of the URL is cached for each interface, and only rebuilt if the
+	 * interface address or TCP port changes.
+	 */
+	String getLocation(const String& path, IpAddress localIp);
+
+	/**
+	 * @brief Get the local interface address on which a remote host is reachable
+	 * @param remoteIp Address of remote host
+	 * @retval IpAddress Access point address if remote is on that network, otherwise station address
+	 */
+	static IpAddress getLocalIp(IpAddress remoteIp);
+
 	String getField(Field desc) override;
 
 	bool onHttpRequest(HttpServerConnection& connection) override;
 
-	void search(const SearchFilter& filter) override;
+	void searchSelf(const SearchFilter& filter) override;
 
 	RootDevice* getNext()
 	{
@@ -60,7 +85,10 @@ public:
 	 */
 	void setTcpPort(uint16_t port)
 	{
-		tcpPort = port;
+		if(port != tcpPort) {
+			tcpPort = port;
+			clearBaseURLs();
+		}
 	}
 
 	uint16_t getTcpPort() const
@@ -68,8 +96,46 @@ public:
 		return tcpPort;
 	}
 
+	/**
+	 * @brief Get version number for descriptions of this device tree
+	 * @note This changes whenever `DeviceHost::deviceChanged()` is called for the tree
+	 */
+	uint32_t getDescriptionVersion() const
+	{
+		return descriptionVersion;
+	}
+
+	/**
+	 * @brief Called by the framework when descriptions for this tree may have changed
+	 */
+	void descriptionChanged();
+
+	/**
+	 * @brief Handle a conditional GET for a description belonging to this tree
+	 * @param connection
+	 * @param compressed true if the gzip-encoded variant is to be sent
+	 * @retval bool true if '304 Not Modified' has been set, in which case no content is to be sent
+	 *
+	 * Otherwise the response gets ETag and, if the system clock is set, Last-Modified headers.
+	 * These are derived from the description version, so no description needs to be created.
+	 * Each encoding is a separate representation so gets its own strong ETag.
+	 */
+	bool checkNotModified(HttpServerConnection& connection, bool compressed = false);
+
 private:
+	const String& getBaseURL(IpAddress localIp);
+	void clearBaseURLs();
+	String getETag(bool compressed) const;
+
+	struct BaseURL {
+		IpAddress localIp;
+		String url; ///< e.g. "http://192.168.1.10:8080"
+	};
+	BaseURL baseURLs[UPNP_URL_CACHE_SIZE];
+	uint8_t nextBaseURL{0}; ///< Next cache entry to be replaced
 	uint16_t tcpPort{80};
+	uint32_t descriptionVersion{1};
+	time_t descriptionModified{0}; ///< UTC time of last change, 0 if not known
 };
 
 using RootDeviceList = ObjectList<RootDevice>;
@@ -0,0 +1,112 @@
+/**
+ * SearchIndex.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Object.h"
+
+namespace UPnP
+{
+/**
+ * @brief Lookup table for `urn:` and `uuid:` search targets
+ *
+ * Each device contributes entries for its UDN and deviceType, and each service for its serviceType.
+ * Entries are kept sorted by the hash of their target string so a search requires only a binary
+ * search, followed by a single field comparison to confirm each candidate.
+ *
+ * The index must be updated whenever a registered device tree changes.
+ * `DeviceHost` takes care of this, deferring the rebuild until the index is next used
+ * so that building a tree one object at a time doesn't re-index it at every step.
+ */
+class SearchIndex
+{
+public:
+	~SearchIndex()
+	{
+		clear();
+	}
+
+	/**
+	 * @brief Add entries for a root device, its embedded devices and services
+	 * @retval bool false if memory allocation failed
+	 */
+	bool add(RootDevice* root);
+
+	/**
+	 * @brief Remove all entries for a root device
+	 */
+	void remove(RootDevice* root);
+
+	/**
+	 * @brief Rebuild entries for a root device
+	 */
+	bool update(RootDevice* root)
+	{
+		remove(root);
+		return add(root);
+	}
+
+	/**
+	 * @brief Rebuild all entries
+	 * @param first Head of a list of root devices
+	 * @retval bool false if memory allocation failed
+	 * @note Entries are collected and sorted once, so this is O(n log n)
+	 */
+	bool rebuild(RootDevice* first);
+
+	void clear();
+
+	/**
+	 * @brief Find matches for a `SearchTarget::type` or `SearchTarget::uuid` filter
+	 * @note Callback is invoked for each match
+	 */
+	void search(const SearchFilter& filter) const;
+
+	unsigned count() const
+	{
+		return count_;
+	}
+
+	/**
+	 * @brief Get number of entries for a root device
+	 * @note The number of matches for an `ssdp:all` search of the tree is one more than this,
+	 * for the `upnp:rootdevice` match
+	 */
+	unsigned count(const RootDevice* root) const;
+
+private:
+	struct Entry {
+		uint32_t hash;
+		Object* object;
+		RootDevice* root;
+		SearchMatch match;
+	};
+
+	bool append(RootDevice* root);
+	bool append(const Entry& entry);
+	void sort();
+	unsigned lowerBound(uint32_t hash) const;
+
+private:
+	Entry* entries{nullptr};
+	uint16_t count_{0};
+	uint16_t capacity{0};
+};
+
+} // namespace UPnP
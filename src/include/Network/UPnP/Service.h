@@ -20,6 +20,7 @@
 #pragma once
 
 #include "Object.h"
+#include "Descriptor.h"
 #include "ObjectList.h"
 #include "Action.h"
 #include "Constants.h"
@@ -56,16 +57,53 @@ public:
 		MAX
 	};
 
+	using Descriptor = ObjectDescriptor<Field>;
+
 	RootDevice* getRoot() override;
 
 	void search(const SearchFilter& filter) override;
+	String getTargetString(SearchMatch match) override;
+	bool matchTarget(SearchMatch match, const String& target) override;
 	bool formatMessage(Message& msg, MessageSpec& ms) override;
 
 	bool onHttpRequest(HttpServerConnection& connection) override;
 
 	virtual String getField(Field desc);
 
-	XML::Node* getDescription(XML::Document& doc, DescType descType) override;
+	/**
+	 * @brief Get the static descriptor for this service, if it has one
+	 * @retval Descriptor* nullptr if fields are all obtained from `getField()`
+	 */
+	virtual const Descriptor* getDescriptor()
+	{
+		return nullptr;
+	}
+
+	/**
+	 * @brief Get a field value, using the memoized value if field caching is enabled
+	 * @see `Object::enableFieldCache()`
+	 */
+	String getCachedField(Field desc);
+
+	/**
+	 * @brief Write a field value
+	 * @param p Output
+	 * @param desc
+	 * @retval size_t Number of characters written
+	 *
+	 * Used to build descriptions without creating temporary String objects.
+	 * The default implementation prints the memoized value if field caching is enabled,
+	 * otherwise the value from `getField()`.
+	 * Override this together with `getField()` to print flash strings directly.
+	 */
+	virtual size_t printField(Print& p, Field desc);
+
+	/**
+	 * @brief Compare a field value, using the descriptor if available
+	 */
+	bool matchField(Field desc, const String& value);
+
+	const FlashString* writeDescription(XmlWriter& writer, DescType descType) override;
 
 	ItemEnumerator* getList(unsigned index, String& name) override;
 
@@ -99,3 +137,10 @@ private:
 } // namespace UPnP
 
 String toString(UPnP::Service::Field field);
+
+bool fromString(const char* name, UPnP::Service::Field& field);
+
+inline bool fromString(const String& name, UPnP::Service::Field& field)
+{
+	return fromString(name.c_str(), field);
+}
@@ -0,0 +1,134 @@
+/**
+ * TreeWalker.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Object.h"
+
+/**
+ * @brief Maximum depth of device tree which may be walked
+ */
+#ifndef UPNP_TREE_DEPTH
+#define UPNP_TREE_DEPTH 8
+#endif
+
+namespace UPnP
+{
+class Device;
+class DeviceCollection;
+class ServiceCollection;
+
+/**
+ * @brief Searches device trees one object at a time, so the search can be resumed later
+ *
+ * Objects are visited in the same order as `Device::search()`: each device, followed by its services
+ * and then its embedded devices. As with searches, only persistent collection items are included.
+ *
+ * The walker holds pointers into the tree. If the tree changes the walk must be started again using `restart()`,
+ * or moved on using `skipTree()`.
+ */
+class TreeWalker
+{
+public:
+	~TreeWalker()
+	{
+		clear();
+	}
+
+	/**
+	 * @brief Start a new walk
+	 * @param device The first device tree to visit
+	 * @param siblings Continue with the trees following this one, e.g. all registered root devices
+	 * @param descend Include embedded devices and services
+	 */
+	void begin(Device* device, bool siblings, bool descend);
+
+	/**
+	 * @brief Start again from the beginning, with the same settings
+	 */
+	void restart()
+	{
+		begin(first, siblings, descend);
+	}
+
+	/**
+	 * @brief Search the next object
+	 * @param filter Callback is invoked for each match
+	 * @retval bool false if the walk is complete, in which case nothing was searched
+	 */
+	bool step(const SearchFilter& filter);
+
+	/**
+	 * @brief Abandon the current tree and move on to the next one, if any
+	 */
+	void skipTree();
+
+	/**
+	 * @brief Called before a tree is removed from the list of siblings
+	 * @param device Top-level device of the tree being removed
+	 *
+	 * If the walk is in that tree then it moves on to the next one.
+	 */
+	void removed(Device* device);
+
+	/**
+	 * @brief Get the root device for the tree currently being walked
+	 * @retval RootDevice* nullptr if walk is complete or the tree isn't attached to a root
+	 */
+	RootDevice* getTreeRoot() const
+	{
+		return treeRoot;
+	}
+
+	bool isFinished() const
+	{
+		return depth == 0;
+	}
+
+private:
+	enum class State : uint8_t {
+		self,
+		services,
+		serviceCollection,
+		devices,
+		deviceCollection,
+	};
+
+	struct Frame {
+		Device* device;
+		Object* item; ///< Next item in list
+		ServiceCollection* services;
+		DeviceCollection* devices;
+		State state;
+	};
+
+	bool push(Device* device);
+	void pop();
+	void clear();
+	void startTree(Device* device);
+
+	Frame stack[UPNP_TREE_DEPTH];
+	Device* first{nullptr};
+	RootDevice* treeRoot{nullptr};
+	uint8_t depth{0};
+	bool siblings{false};
+	bool descend{false};
+};
+
+} // namespace UPnP
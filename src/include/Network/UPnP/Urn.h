@@ -28,6 +28,8 @@
 
 namespace UPnP
 {
+class UrnRef;
+
 /**
  * @brief Structure for UPnP URNs
  */
@@ -82,12 +84,92 @@ public:
 		return kind != Kind::none;
 	}
 
+	/**
+	 * @brief Get hash of the URN string
+	 * @retval uint32_t Same as `Hash::fnv1a(toString())`, but without building the string
+	 */
+	uint32_t hash() const;
+
+	/**
+	 * @brief Compare with a parsed URN string
+	 */
+	bool operator==(const UrnRef& ref) const;
+
+	bool operator!=(const UrnRef& ref) const
+	{
+		return !operator==(ref);
+	}
+
 	Kind kind{};
 	String domain;		///< e.g. PnP::schemas_upnp_org
 	String type;		///< e.g. "Basic"
 	uint8_t version{1}; ///< e.g. 1
 };
 
+/**
+ * @brief Non-owning, pre-hashed view of a URN string
+ *
+ * Parsing does not copy or allocate: `domain` and `type` refer into the source,
+ * which must remain valid whilst the UrnRef is in use.
+ * Comparisons check the hash first, then confirm the individual tokens.
+ */
+class UrnRef
+{
+public:
+	UrnRef()
+	{
+	}
+
+	UrnRef(const char* value) : UrnRef(value, (value == nullptr) ? 0 : strlen(value))
+	{
+	}
+
+	UrnRef(const char* value, size_t length)
+	{
+		parse(value, length);
+	}
+
+	UrnRef(const String& value) : UrnRef(value.c_str(), value.length())
+	{
+	}
+
+	/**
+	 * @brief Parse a URN string
+	 * @param value e.g. "urn:schemas-upnp-org:device:Basic:1"
+	 * @param length Number of characters in value
+	 * @retval bool true on success, false if value is not a valid device or service URN
+	 */
+	bool parse(const char* value, size_t length);
+
+	/**
+	 * @brief Determine if URN is valid
+	 */
+	explicit operator bool() const
+	{
+		return kind != Urn::Kind::none;
+	}
+
+	bool operator==(const UrnRef& other) const;
+
+	bool operator==(const Urn& urn) const
+	{
+		return urn == *this;
+	}
+
+	/**
+	 * @brief Create a copy of this URN
+	 */
+	Urn toUrn() const;
+
+	Urn::Kind kind{};
+	uint8_t version{0};
+	uint8_t domainLength{0};
+	uint8_t typeLength{0};
+	const char* domain{nullptr}; ///< Start of domain within source string
+	const char* type{nullptr};   ///< Start of type within source string
+	uint32_t hash{0};			 ///< Hash of complete URN string
+};
+
 /**
  * @brief A UPnP Device URN
  */
@@ -118,7 +200,7 @@ public:
 	}
 
 	ServiceUrn(const String& domain, const String& type, const String& version)
-		: Urn(Urn::Kind::device, domain, type, version.toInt())
+		: Urn(Urn::Kind::service, domain, type, version.toInt())
 	{
 	}
 
@@ -0,0 +1,107 @@
+/**
+ * XmlWriter.h
+ *
+ * Copyright 2020 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming UPnP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with FlashString.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <Print.h>
+#include <Delegate.h>
+#include <WString.h>
+#include <FlashString/String.hpp>
+
+namespace UPnP
+{
+using PrintFieldCallback = Delegate<size_t(Print& p)>;
+
+/**
+ * @brief Writes XML directly into a String, without building a document
+ *
+ * Output is formatted exactly as `XML::serialize()` would, with or without pretty-printing.
+ * Element names are not stored: they are passed again when closing tags,
+ * so memory usage depends only on the output and not on nesting depth.
+ */
+class XmlWriter
+{
+public:
+	/**
+	 * @brief Construct a writer
+	 * @param output Content is appended to this string
+	 * @param pretty Indent with tabs and put each element on a new line
+	 * @param depth Initial nesting level, used when closing an element opened by another writer
+	 */
+	XmlWriter(String& output, bool pretty = false, uint8_t depth = 0) : out(output), pretty(pretty), depth(depth)
+	{
+	}
+
+	/**
+	 * @brief Write the standard XML declaration
+	 */
+	void declaration();
+
+	/**
+	 * @brief Start a new element
+	 * @note Attributes may be added until any other content is written
+	 */
+	void openTag(const FlashString& name);
+
+	void attribute(const FlashString& name, const FlashString& value);
+
+	/**
+	 * @brief Complete the current start tag, if any
+	 */
+	void endStartTag();
+
+	/**
+	 * @brief Close the element most recently opened
+	 * @param name Must match the name passed to `openTag()`
+	 */
+	void closeTag(const FlashString& name);
+
+	/**
+	 * @brief Write an element containing a single value
+	 * @param name Element name
+	 * @param print Called to write the value, which is escaped as required
+	 * @note An empty value is written as `<name/>`
+	 */
+	void field(const FlashString& name, PrintFieldCallback print);
+
+	/**
+	 * @brief Write an element containing a String value
+	 * @retval bool false if the value is null, in which case nothing is written
+	 */
+	bool field(const FlashString& name, const String& value);
+
+	void field(const FlashString& name, unsigned value);
+
+	/**
+	 * @brief Replace reserved characters with entity references
+	 * @param value Text to be inserted into a document, e.g. via a template
+	 */
+	static String escape(const String& value);
+
+private:
+	void indent();
+	void newline();
+
+	String& out;
+	bool pretty;
+	uint8_t depth;
+	bool tagOpen{false}; ///< Start tag awaiting '>'
+};
+
+} // namespace UPnP
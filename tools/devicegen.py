@@ -0,0 +1,356 @@
+#!/usr/bin/env python3
+#
+# devicegen.py
+#
+# Copyright 2020 mikee47 <mike@sillyhouse.net>
+#
+# This file is part of the Sming UPnP Library
+#
+# This library is free software: you can redistribute it and/or modify it under the terms of the
+# GNU General Public License as published by the Free Software Foundation, version 3 or later.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+# without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with FlashString.
+# If not, see <https://www.gnu.org/licenses/>.
+#
+#
+# Generates a RootDevice class from a device description file.
+#
+# Field values in the description may contain placeholders such as `{serialNumber}`,
+# naming any device field. A field is then:
+#
+#   constant    if it contains no placeholders. The value is stored in the class descriptor.
+#   dynamic     if it consists only of its own placeholder, e.g. `<UDN>{UDN}</UDN>`.
+#               The application provides the value by overriding `getField()`.
+#   composite   otherwise, e.g. `<UDN>uuid:Socket-{serialNumber}</UDN>`.
+#               The generated `getField()` builds the value from the other fields.
+#
+# The generated `getField()` also returns the `domain`, `type` and `version` fields,
+# taken from a constant `deviceType`.
+#
+# The description is also stored in flash as a template, with constant values already in place
+# and each dynamic field replaced by a placeholder. Lists such as `serviceList` are copied as-is,
+# so placeholders in them are resolved against the root device fields.
+#
+
+import argparse
+import os
+import re
+import sys
+import xml.etree.ElementTree as ET
+from xml.sax.saxutils import escape
+
+# Must match UPNP_DEVICE_FIELD_MAP in Device.h
+STANDARD_FIELDS = [
+    'deviceType',
+    'friendlyName',
+    'manufacturer',
+    'manufacturerURL',
+    'modelDescription',
+    'modelName',
+    'modelNumber',
+    'modelURL',
+    'serialNumber',
+    'UDN',
+    'presentationURL',
+]
+
+# May be used in placeholders, but aren't part of the description
+CUSTOM_FIELDS = [
+    'domain',
+    'type',
+    'version',
+    'serverId',
+    'baseURL',
+    'descriptionURL',
+]
+
+DEVICE_FIELDS = STANDARD_FIELDS + CUSTOM_FIELDS
+
+DEVICE_XMLNS = 'urn:schemas-upnp-org:device-1-0'
+
+PLACEHOLDER = re.compile(r'\{([^{}]*)\}')
+
+
+def fatal(msg):
+    sys.stderr.write('devicegen: %s\n' % msg)
+    sys.exit(1)
+
+
+def local_name(tag):
+    return tag.split('}')[-1]
+
+
+def cpp_string(s):
+    return '"%s"' % s.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+
+
+def check_placeholders(text, where):
+    for name in PLACEHOLDER.findall(text or ''):
+        if name not in DEVICE_FIELDS:
+            fatal("unknown field '{%s}' in %s" % (name, where))
+
+
+def split_template(text):
+    """Split text into a list of (literal, field) pairs, either of which may be empty"""
+    parts = []
+    pos = 0
+    for m in PLACEHOLDER.finditer(text):
+        parts.append((text[pos:m.start()], None))
+        parts.append((None, m.group(1)))
+        pos = m.end()
+    parts.append((text[pos:], None))
+    return [p for p in parts if p[0] or p[1]]
+
+
+class Field:
+    def __init__(self, name, text, kind=None):
+        self.name = name
+        self.text = text
+        if kind is not None:
+            self.kind = kind
+        elif not PLACEHOLDER.search(text):
+            self.kind = 'constant'
+        elif text == '{%s}' % name:
+            self.kind = 'dynamic'
+        else:
+            self.kind = 'composite'
+
+
+def serialize(elem):
+    """Compact serialization of an element, without namespace prefixes"""
+    tag = local_name(elem.tag)
+    s = '<' + tag
+    for name, value in elem.attrib.items():
+        s += ' %s="%s"' % (local_name(name), escape(value, {'"': '&quot;'}))
+    children = list(elem)
+    text = (elem.text or '').strip() if children else (elem.text or '')
+    if not children and not text:
+        return s + '/>'
+    s += '>' + escape(text)
+    for child in children:
+        s += serialize(child)
+        tail = (child.tail or '').strip()
+        s += escape(tail)
+    return s + '</%s>' % tag
+
+
+def parse(filename):
+    try:
+        root = ET.parse(filename).getroot()
+    except ET.ParseError as err:
+        fatal('%s: %s' % (filename, err))
+
+    if local_name(root.tag) != 'root':
+        fatal("%s: expected 'root' element" % filename)
+
+    fields = []
+    template = '<?xml version="1.0" encoding="utf-8"?>'
+    template += '<root xmlns="%s">' % DEVICE_XMLNS
+    device = None
+    for elem in root:
+        if local_name(elem.tag) != 'device':
+            template += serialize(elem)
+            continue
+        if device is not None:
+            fatal('%s: only one root device supported' % filename)
+        device = elem
+        template += '<device>'
+        for child in device:
+            name = local_name(child.tag)
+            check_placeholders(serialize(child), "'%s'" % name)
+            if name in STANDARD_FIELDS and len(child) == 0:
+                field = Field(name, (child.text or '').strip())
+                fields.append(field)
+                if field.kind == 'constant':
+                    template += '<%s>%s</%s>' % (name, escape(field.text), name)
+                else:
+                    template += '<%s>{%s}</%s>' % (name, name, name)
+            else:
+                template += serialize(child)
+        template += '</device>'
+    template += '</root>'
+
+    if device is None:
+        fatal("%s: no 'device' element" % filename)
+
+    # Custom fields used for searches and URLs are obtained from the device type
+    fieldNames = [f.name for f in fields]
+    deviceType = next((f for f in fields if f.name == 'deviceType'), None)
+    if deviceType is not None and deviceType.kind == 'constant':
+        urn = deviceType.text.split(':')
+        if len(urn) == 5 and urn[0] == 'urn' and urn[2] == 'device':
+            for name, value in zip(['domain', 'type', 'version'], [urn[1], urn[3], urn[4]]):
+                if name not in fieldNames:
+                    fields.append(Field(name, value, 'custom'))
+
+    return fields, template
+
+
+def generate_header(args, fields):
+    lines = [
+        '/*',
+        ' * %s' % os.path.basename(args.output + '.h'),
+        ' *',
+        ' * Generated by devicegen.py from %s. Do not edit.' % os.path.basename(args.input),
+        ' */',
+        '',
+        '#pragma once',
+        '',
+        '#include <Network/UPnP/RootDevice.h>',
+        '',
+    ]
+    if args.namespace:
+        lines += ['namespace %s' % args.namespace, '{']
+    lines += [
+        'class %s : public UPnP::RootDevice' % args.classname,
+        '{',
+        'public:',
+        '\tconst Descriptor* getDescriptor() override;',
+    ]
+    if any(f.kind in ['composite', 'custom'] for f in fields):
+        lines += ['\tString getField(Field desc) override;']
+    lines += [
+        '\tIDataSourceStream* createDescription() override;',
+        '};',
+    ]
+    if args.namespace:
+        lines += ['', '} // namespace %s' % args.namespace]
+    return '\n'.join(lines) + '\n'
+
+
+def generate_source(args, fields, template):
+    cls = args.classname
+    lines = [
+        '/*',
+        ' * %s' % os.path.basename(args.output + '.cpp'),
+        ' *',
+        ' * Generated by devicegen.py from %s. Do not edit.' % os.path.basename(args.input),
+        ' */',
+        '',
+        '#include "%s"' % os.path.basename(args.output + '.h'),
+        '#include <Network/UPnP/XmlWriter.h>',
+        '#include <FlashString/TemplateStream.hpp>',
+        '',
+    ]
+    if args.namespace:
+        lines += ['namespace %s' % args.namespace, '{']
+    lines += ['namespace', '{']
+
+    for f in fields:
+        if f.kind == 'constant':
+            lines += ['DEFINE_FSTR_LOCAL(fs_%s, %s)' % (f.name, cpp_string(f.text))]
+
+    # One line per element keeps the output readable
+    lines += ['', 'DEFINE_FSTR_LOCAL(fs_description,']
+    for chunk in re.findall(r'.*?(?:</[^>]+>|/>|\?>|$)', template):
+        if chunk:
+            lines += ['\t\t\t\t  %s' % cpp_string(chunk)]
+    lines[-1] += ')'
+
+    lines += [
+        '',
+        'using Field = UPnP::Device::Field;',
+        '',
+        'constexpr UPnP::Device::Descriptor descriptor PROGMEM =',
+        '\tUPnP::Device::Descriptor()',
+    ]
+    for f in fields:
+        if f.kind == 'constant':
+            lines += ['\t\t.value(Field::%s, fs_%s)' % (f.name, f.name)]
+        elif f.kind != 'custom':
+            lines += ['\t\t.dynamic(Field::%s)' % f.name]
+    lines[-1] += ';'
+    lines += ['', '} // namespace', '']
+
+    lines += [
+        'const UPnP::Device::Descriptor* %s::getDescriptor()' % cls,
+        '{',
+        '\treturn &descriptor;',
+        '}',
+        '',
+    ]
+
+    composites = [f for f in fields if f.kind == 'composite']
+    customs = [f for f in fields if f.kind == 'custom']
+    if composites or customs:
+        lines += [
+            'String %s::getField(Field desc)' % cls,
+            '{',
+            '\tswitch(desc) {',
+        ]
+        for f in customs:
+            lines += ['\tcase Field::%s:' % f.name, '\t\treturn F(%s);' % cpp_string(f.text)]
+        if customs:
+            lines += ['']
+        for f in composites:
+            lines += ['\tcase Field::%s: {' % f.name, '\t\tString s;']
+            for literal, name in split_template(f.text):
+                if literal:
+                    lines += ['\t\ts += F(%s);' % cpp_string(literal)]
+                else:
+                    lines += ['\t\ts += getCachedField(Field::%s);' % name]
+            lines += ['\t\treturn s;', '\t}', '']
+        lines += [
+            '\tdefault:',
+            '\t\treturn RootDevice::getField(desc);',
+            '\t}',
+            '}',
+            '',
+        ]
+
+    lines += [
+        'IDataSourceStream* %s::createDescription()' % cls,
+        '{',
+        '\tauto tmpl = new FSTR::TemplateStream(fs_description);',
+        '\ttmpl->onGetValue([this](const char* name) -> String {',
+        '\t\tField field;',
+        '\t\tString s;',
+        '\t\tif(fromString(name, field)) {',
+        '\t\t\ts = UPnP::XmlWriter::escape(getCachedField(field));',
+        '\t\t}',
+        '\t\treturn s;',
+        '\t});',
+        '\treturn tmpl;',
+        '}',
+    ]
+
+    if args.namespace:
+        lines += ['', '} // namespace %s' % args.namespace]
+    return '\n'.join(lines) + '\n'
+
+
+def write_file(filename, content):
+    # Leave unchanged files alone so dependent sources aren't rebuilt
+    try:
+        with open(filename) as f:
+            if f.read() == content:
+                return
+    except IOError:
+        pass
+    with open(filename, 'w') as f:
+        f.write(content)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate a UPnP RootDevice class from a device description')
+    parser.add_argument('input', help='Device description XML file')
+    parser.add_argument('output', help='Output path without extension: .h and .cpp files are written')
+    parser.add_argument('--class', dest='classname', required=True, help='Name of the generated class')
+    parser.add_argument('--namespace', help='Namespace for the generated class')
+    args = parser.parse_args()
+
+    fields, template = parse(args.input)
+
+    dirname = os.path.dirname(args.output)
+    if dirname:
+        os.makedirs(dirname, exist_ok=True)
+    write_file(args.output + '.h', generate_header(args, fields))
+    write_file(args.output + '.cpp', generate_source(args, fields, template))
+
+
+if __name__ == '__main__':
+    main()